@@ -0,0 +1,1134 @@
+/* GX for the host build. Every call is encoded into a command stream,
+ * the main FIFO or the display list being recorded, and the stream is
+ * executed wherever the game would wait for the GPU. Vertex data is laid
+ * out byte for byte like on the Wii, so display list sizes and bytes per
+ * frame are the real ones. State commands use their own encoding, no
+ * larger than the register writes libogc would send.
+ *
+ * Like libogc, the vertex descriptor and formats are only sent at the
+ * next GX_Begin or display list call after they changed, so a display
+ * list recorded after changing them carries them. */
+#include "shim.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+namespace host {
+
+enum Opcode {
+    OP_NOP = 0x00,
+    OP_VTX_DESC = 0x08,
+    OP_VTX_FORMAT = 0x09,
+    OP_ARRAY = 0x0a,
+    OP_MATRIX = 0x10,
+    OP_PROJECTION = 0x11,
+    OP_VIEWPORT = 0x12,
+    OP_TEXGEN = 0x13,
+    OP_CALL = 0x40,
+    OP_INV_VTX_CACHE = 0x48,
+    OP_SCISSOR = 0x60,
+    OP_Z_MODE = 0x61,
+    OP_Z_COMP_LOC = 0x62,
+    OP_BLEND_MODE = 0x63,
+    OP_ALPHA_COMPARE = 0x64,
+    OP_COLOR_UPDATE = 0x65,
+    OP_ALPHA_UPDATE = 0x66,
+    OP_TEV_OP = 0x67,
+    OP_OTHER = 0x68,
+    OP_TEXTURE = 0x70,
+    OP_TLUT = 0x71,
+    OP_INV_TEX = 0x72,
+    OP_COPY_CLEAR = 0x73,
+    OP_DISP_COPY_SRC = 0x74,
+    OP_TEX_COPY_SRC = 0x75,
+    OP_TEX_COPY_DST = 0x76,
+    OP_COPY_TEX = 0x77,
+    OP_COPY_DISP = 0x78,
+    OP_DRAW_SYNC = 0x79,
+    OP_DRAW_DONE = 0x7a,
+    OP_PIX_SYNC = 0x7b,
+    OP_PRIMITIVE = 0x80 // or'd with the primitive and the vertex format
+};
+
+/* State the shim doesn't emulate, only counted and traced */
+enum OtherState {
+    OTHER_CULL_MODE,
+    OTHER_CLIP_MODE,
+    OTHER_NUM_CHANS,
+    OTHER_NUM_TEXGENS,
+    OTHER_TEV_ORDER,
+    OTHER_PIXEL_FORMAT,
+    OTHER_COPY_FILTER,
+    OTHER_FIELD_MODE,
+    OTHER_DISP_COPY_DST,
+    OTHER_DISP_COPY_GAMMA
+};
+
+static const char* other_names[] = {
+    "cull mode", "clip mode", "color channels", "texgens", "tev order",
+    "pixel format", "copy filter", "field mode", "display copy size", "display copy gamma"
+};
+
+void FrameCounters::reset() {
+    memset(this, 0, sizeof(*this));
+}
+
+void FrameCounters::add(const FrameCounters &other) {
+    this->fifo_bytes += other.fifo_bytes;
+    this->list_bytes += other.list_bytes;
+    this->draw_calls += other.draw_calls;
+    this->vertices += other.vertices;
+    this->state_changes += other.state_changes;
+    this->matrix_loads += other.matrix_loads;
+    this->texture_loads += other.texture_loads;
+    this->list_calls += other.list_calls;
+    this->efb_copies += other.efb_copies;
+    this->quads += other.quads;
+    this->quad_draws += other.quad_draws;
+}
+
+void GpuState::reset() {
+    memset(this, 0, sizeof(*this));
+    for(int row = 0; row < 64; row += 3) {
+        for(int i = 0; i < 3 && row + i < 64; i++) {
+            this->xf_rows[row + i][i] = 1.0F;
+        }
+    }
+    // GX_IDENTITY isn't on a multiple of three
+    memset(this->xf_rows[GX_IDENTITY], 0, 3 * sizeof(this->xf_rows[0]));
+    this->xf_rows[GX_IDENTITY][0] = 1.0F;
+    this->xf_rows[GX_IDENTITY + 1][1] = 1.0F;
+    this->xf_rows[GX_IDENTITY + 2][2] = 1.0F;
+    this->texgen_type = GX_TG_MTX2x4;
+    this->texgen_matrix = GX_IDENTITY;
+    this->tev_op = GX_REPLACE;
+    this->z_enable = GX_TRUE;
+    this->z_func = GX_LEQUAL;
+    this->z_update = GX_TRUE;
+    this->z_before_tex = GX_TRUE;
+    this->alpha_comp0 = GX_ALWAYS;
+    this->alpha_comp1 = GX_ALWAYS;
+    this->color_update = GX_TRUE;
+    this->alpha_update = GX_TRUE;
+    this->clear_z = 0x00ffffff;
+    this->clear_color.a = 0xff;
+}
+
+/* What the CPU side knows: where commands go and the state libogc only
+ * sends once something is drawn */
+class Recorder {
+public:
+    std::vector<u8> fifo;
+    u8* list;
+    u32 list_capacity;
+    u32 list_size;
+    bool list_overflow;
+    u8 vtx_desc[GX_VA_MAXATTR];
+    VertexFormat formats[GX_MAXVTXFMT];
+    bool desc_dirty;
+    u8 formats_dirty; // one bit per vertex format
+    GXDrawSyncCallback draw_sync_callback;
+    u16 draw_sync_token;
+    void reset() {
+        this->fifo.clear();
+        this->list = NULL;
+        this->list_capacity = 0;
+        this->list_size = 0;
+        this->list_overflow = false;
+        memset(this->vtx_desc, 0, sizeof(this->vtx_desc));
+        memset(this->formats, 0, sizeof(this->formats));
+        this->desc_dirty = true;
+        this->formats_dirty = 0xff;
+        this->draw_sync_token = 0;
+    }
+    void put(const void* data, u32 size) {
+        if(this->list == NULL) {
+            const u8* bytes = (const u8*)data;
+            this->fifo.insert(this->fifo.end(), bytes, bytes + size);
+            return;
+        }
+        if(this->list_size + size > this->list_capacity) {
+            this->list_overflow = true;
+            return;
+        }
+        memcpy(this->list + this->list_size, data, size);
+        this->list_size += size;
+    }
+    template<typename T>
+    void put(T value) {
+        this->put(&value, sizeof(T));
+    }
+    /// Sends the vertex descriptor and formats that changed since they were last sent
+    void send_dirty_state() {
+        if(this->desc_dirty) {
+            // two bits an attribute, the same 52 bits libogc splits over two registers
+            u64 packed = 0;
+            for(int attribute = 0; attribute < GX_VA_MAXATTR; attribute++) {
+                packed |= (u64)(this->vtx_desc[attribute] & 3) << (attribute * 2);
+            }
+            this->put((u8)OP_VTX_DESC);
+            this->put(&packed, 7);
+            this->desc_dirty = false;
+        }
+        for(int format = 0; format < GX_MAXVTXFMT; format++) {
+            if(!(this->formats_dirty & (1 << format))) continue;
+            this->put((u8)OP_VTX_FORMAT);
+            this->put((u8)format);
+            this->put(&this->formats[format], sizeof(VertexFormat));
+        }
+        this->formats_dirty = 0;
+    }
+};
+
+static Recorder recorder;
+static GpuState gpu;
+static FrameCounters counters;
+static FrameCounters totals;
+static u32 frames = 0;
+
+/* Reading a command stream, which may point into a display list */
+struct Reader {
+    const u8* data;
+    u32 size;
+    u32 offset;
+    bool overrun;
+    bool has(u32 bytes) {
+        if(this->offset + bytes > this->size) this->overrun = true;
+        return !this->overrun;
+    }
+    void get(void* out, u32 bytes) {
+        if(!this->has(bytes)) {
+            memset(out, 0, bytes);
+            return;
+        }
+        memcpy(out, this->data + this->offset, bytes);
+        this->offset += bytes;
+    }
+    template<typename T>
+    T get() {
+        T value;
+        this->get(&value, sizeof(T));
+        return value;
+    }
+};
+
+static void trace(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+static void trace(const char* format, ...) {
+    if(config.trace == NULL) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(config.trace, format, args);
+    va_end(args);
+}
+
+static int component_size(u8 type) {
+    switch(type) {
+        case GX_U8: case GX_S8: return 1;
+        case GX_U16: case GX_S16: return 2;
+        default: return 4;
+    }
+}
+
+static f32 read_component(const u8* data, u8 type, u8 frac) {
+    f32 scale = 1.0F / (1 << frac);
+    switch(type) {
+        case GX_U8: return *data * scale;
+        case GX_S8: return *(const s8*)data * scale;
+        case GX_U16: { u16 value; memcpy(&value, data, 2); return value * scale; }
+        case GX_S16: { s16 value; memcpy(&value, data, 2); return value * scale; }
+        default: { f32 value; memcpy(&value, data, 4); return value; }
+    }
+}
+
+/// Reads an attribute with count components, straight from the stream
+/// or through an index into its array
+static void read_attribute(Reader &reader, int attribute, int count, u8 type, u8 frac, f32* out) {
+    int size = component_size(type);
+    u8 mode = gpu.vtx_desc[attribute];
+    const u8* data;
+    u8 direct[16];
+    if(mode == GX_DIRECT) {
+        reader.get(direct, count * size);
+        data = direct;
+    } else {
+        u32 index = mode == GX_INDEX8 ? reader.get<u8>() : reader.get<u16>();
+        const Array &array = gpu.arrays[attribute];
+        if(array.data == NULL) {
+            memset(out, 0, count * sizeof(f32));
+            return;
+        }
+        data = array.data + index * array.stride;
+    }
+    for(int i = 0; i < count; i++) {
+        out[i] = read_component(data + i * size, type, frac);
+    }
+}
+
+/// Reads one vertex and takes it through the position, projection and
+/// texture matrices to the screen
+static ScreenVertex read_vertex(Reader &reader, const VertexFormat &format) {
+    u8 position_matrix = GX_PNMTX0;
+    u8 texture_matrix = gpu.texgen_matrix;
+    if(gpu.vtx_desc[GX_VA_PTNMTXIDX] == GX_DIRECT) position_matrix = reader.get<u8>();
+    for(int attribute = GX_VA_TEX0MTXIDX; attribute <= GX_VA_TEX7MTXIDX; attribute++) {
+        if(gpu.vtx_desc[attribute] != GX_DIRECT) continue;
+        u8 index = reader.get<u8>();
+        if(attribute == GX_VA_TEX0MTXIDX) texture_matrix = index;
+    }
+    f32 position[3] = { 0, 0, 0 };
+    f32 texcoord[2] = { 0, 0 };
+    if(gpu.vtx_desc[GX_VA_POS] != GX_NONE) {
+        read_attribute(reader, GX_VA_POS, format.pos_count == GX_POS_XYZ ? 3 : 2,
+                format.pos_type, format.pos_frac, position);
+    }
+    if(gpu.vtx_desc[GX_VA_TEX0] != GX_NONE) {
+        read_attribute(reader, GX_VA_TEX0, format.tex_count == GX_TEX_ST ? 2 : 1,
+                format.tex_type, format.tex_frac, texcoord);
+    }
+
+    f32 world[4];
+    const f32 (*rows)[4] = &gpu.xf_rows[position_matrix % 64];
+    for(int i = 0; i < 3; i++) {
+        world[i] = rows[i][0] * position[0] + rows[i][1] * position[1] + rows[i][2] * position[2] + rows[i][3];
+    }
+    world[3] = 1.0F;
+    f32 clip[4];
+    for(int i = 0; i < 4; i++) {
+        clip[i] = gpu.projection[i][0] * world[0] + gpu.projection[i][1] * world[1] +
+            gpu.projection[i][2] * world[2] + gpu.projection[i][3] * world[3];
+    }
+    if(clip[3] == 0.0F) clip[3] = 1.0F;
+    const f32* viewport = gpu.viewport;
+    ScreenVertex vertex;
+    vertex.x = viewport[0] + viewport[2] * (1.0F + clip[0] / clip[3]) / 2;
+    vertex.y = viewport[1] + viewport[3] * (1.0F - clip[1] / clip[3]) / 2;
+    // clip space z runs from -1 at the camera to 0 at the far plane
+    vertex.z = viewport[4] + (viewport[5] - viewport[4]) * (clip[2] / clip[3] + 1.0F);
+
+    const f32 (*texture_rows)[4] = &gpu.xf_rows[texture_matrix % 64];
+    f32 input[4] = { texcoord[0], texcoord[1], 1.0F, 1.0F };
+    f32 s = 0, t = 0, q = 1.0F;
+    s = texture_rows[0][0] * input[0] + texture_rows[0][1] * input[1] + texture_rows[0][2] * input[2] + texture_rows[0][3] * input[3];
+    t = texture_rows[1][0] * input[0] + texture_rows[1][1] * input[1] + texture_rows[1][2] * input[2] + texture_rows[1][3] * input[3];
+    if(gpu.texgen_type == GX_TG_MTX3x4) {
+        q = texture_rows[2][0] * input[0] + texture_rows[2][1] * input[1] + texture_rows[2][2] * input[2] + texture_rows[2][3] * input[3];
+        if(q == 0.0F) q = 1.0F;
+    }
+    vertex.s = s / q;
+    vertex.t = t / q;
+
+    if(config.trace_vertices) {
+        trace("    pos %g %g %g mtx %u tex %g %g mtx %u -> screen %.2f %.2f %.5f uv %.5f %.5f\n",
+                position[0], position[1], position[2], position_matrix, texcoord[0], texcoord[1],
+                texture_matrix, vertex.x, vertex.y, vertex.z, vertex.s, vertex.t);
+    }
+    return vertex;
+}
+
+static const char* primitive_name(u8 primitive) {
+    switch(primitive) {
+        case GX_QUADS: return "quads";
+        case GX_TRIANGLES: return "triangles";
+        case GX_TRIANGLESTRIP: return "triangle strip";
+        case GX_TRIANGLEFAN: return "triangle fan";
+        case GX_LINES: return "lines";
+        case GX_POINTS: return "points";
+        default: return "unknown";
+    }
+}
+
+static void execute_primitive(Reader &reader, u8 opcode) {
+    u8 primitive = opcode & 0xf8;
+    const VertexFormat &format = gpu.formats[opcode & 7];
+    u16 count = reader.get<u16>();
+    counters.draw_calls++;
+    counters.vertices += count;
+    if(primitive == GX_QUADS) {
+        counters.quads += count / 4;
+        counters.quad_draws++;
+    }
+    trace("  %s, format %d, %u vertices\n", primitive_name(primitive), opcode & 7, count);
+
+    std::vector<ScreenVertex> vertices(count);
+    for(int n = 0; n < count && !reader.overrun; n++) {
+        vertices[n] = read_vertex(reader, format);
+    }
+    if(!config.rasterize || reader.overrun) return;
+    switch(primitive) {
+        case GX_QUADS:
+            for(int n = 0; n + 3 < count; n += 4) {
+                raster_triangle(gpu, vertices[n], vertices[n + 1], vertices[n + 2]);
+                raster_triangle(gpu, vertices[n], vertices[n + 2], vertices[n + 3]);
+            }
+            break;
+        case GX_TRIANGLES:
+            for(int n = 0; n + 2 < count; n += 3) {
+                raster_triangle(gpu, vertices[n], vertices[n + 1], vertices[n + 2]);
+            }
+            break;
+        case GX_TRIANGLESTRIP:
+            for(int n = 0; n + 2 < count; n++) {
+                if(n % 2 == 0) raster_triangle(gpu, vertices[n], vertices[n + 1], vertices[n + 2]);
+                else raster_triangle(gpu, vertices[n + 1], vertices[n], vertices[n + 2]);
+            }
+            break;
+        case GX_TRIANGLEFAN:
+            for(int n = 1; n + 1 < count; n++) {
+                raster_triangle(gpu, vertices[0], vertices[n], vertices[n + 1]);
+            }
+            break;
+        default:
+            // points and lines aren't drawn by the game
+            break;
+    }
+}
+
+static void end_frame(bool clear) {
+    trace("frame %u: %llu fifo bytes, %llu display list bytes, %u draw calls, %u vertices\n",
+            frames, (unsigned long long)counters.fifo_bytes, (unsigned long long)counters.list_bytes,
+            counters.draw_calls, counters.vertices);
+    if(config.stats != NULL) {
+        fprintf(config.stats, "%u,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.2f\n", frames,
+                (unsigned long long)counters.fifo_bytes, (unsigned long long)counters.list_bytes,
+                counters.draw_calls, counters.vertices, counters.state_changes, counters.matrix_loads,
+                counters.texture_loads, counters.list_calls, counters.efb_copies, counters.quads,
+                counters.quad_draws, counters.quad_draws > 0 ? (double)counters.quads / counters.quad_draws : 0.0);
+    }
+    if(frames > 0) totals.add(counters);
+
+    bool snapshot = false;
+    if(config.snapshot_dir != NULL && frames > 0) {
+        if(config.snapshot_frames.empty()) {
+            snapshot = frames == config.frames;
+        }
+        for(u32 frame : config.snapshot_frames) {
+            snapshot = snapshot || frame == frames;
+        }
+    }
+    if(config.rasterize) {
+        if(snapshot) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/frame%05u.png", config.snapshot_dir, frames);
+            raster_copy_disp(gpu, false);
+            if(!raster_write_png(path)) {
+                fprintf(stderr, "host: can't write %s\n", path);
+            }
+        }
+        raster_copy_disp(gpu, clear);
+    }
+    counters.reset();
+    frames++;
+}
+
+static void execute(const u8* data, u32 size, int depth);
+
+static void execute_command(Reader &reader, int depth) {
+    u8 opcode = reader.get<u8>();
+    if(opcode & OP_PRIMITIVE) {
+        execute_primitive(reader, opcode);
+        return;
+    }
+    switch(opcode) {
+        case OP_NOP:
+            break;
+        case OP_VTX_DESC: {
+            u64 packed = 0;
+            reader.get(&packed, 7);
+            for(int attribute = 0; attribute < GX_VA_MAXATTR; attribute++) {
+                gpu.vtx_desc[attribute] = (packed >> (attribute * 2)) & 3;
+            }
+            counters.state_changes++;
+            trace("  vertex descriptor pos %u tex0 %u pnmtx %u tex0mtx %u\n", gpu.vtx_desc[GX_VA_POS],
+                    gpu.vtx_desc[GX_VA_TEX0], gpu.vtx_desc[GX_VA_PTNMTXIDX], gpu.vtx_desc[GX_VA_TEX0MTXIDX]);
+            break;
+        }
+        case OP_VTX_FORMAT: {
+            u8 format = reader.get<u8>() & 7;
+            reader.get(&gpu.formats[format], sizeof(VertexFormat));
+            counters.state_changes++;
+            trace("  vertex format %u\n", format);
+            break;
+        }
+        case OP_ARRAY: {
+            u8 attribute = reader.get<u8>() % GX_VA_MAXATTR;
+            gpu.arrays[attribute].stride = reader.get<u8>();
+            gpu.arrays[attribute].data = reader.get<const u8*>();
+            counters.state_changes++;
+            trace("  array %u stride %u\n", attribute, gpu.arrays[attribute].stride);
+            break;
+        }
+        case OP_MATRIX: {
+            u8 row = reader.get<u8>();
+            u8 rows = reader.get<u8>();
+            for(int i = 0; i < rows; i++) {
+                reader.get(gpu.xf_rows[(row + i) % 64], 4 * sizeof(f32));
+            }
+            counters.matrix_loads++;
+            trace("  matrix %u, %u rows, translation %g %g\n", row, rows, gpu.xf_rows[row % 64][3], gpu.xf_rows[(row + 1) % 64][3]);
+            break;
+        }
+        case OP_PROJECTION:
+            reader.get<u8>();
+            reader.get(gpu.projection, sizeof(Mtx44));
+            counters.matrix_loads++;
+            trace("  projection\n");
+            break;
+        case OP_VIEWPORT:
+            reader.get(gpu.viewport, sizeof(gpu.viewport));
+            counters.state_changes++;
+            trace("  viewport %g %g %g %g\n", gpu.viewport[0], gpu.viewport[1], gpu.viewport[2], gpu.viewport[3]);
+            break;
+        case OP_TEXGEN:
+            gpu.texgen_type = reader.get<u8>();
+            gpu.texgen_matrix = reader.get<u8>();
+            counters.state_changes++;
+            trace("  texgen matrix %u\n", gpu.texgen_matrix);
+            break;
+        case OP_CALL: {
+            const u8* list = reader.get<const u8*>();
+            u32 list_size = reader.get<u32>();
+            counters.list_calls++;
+            counters.list_bytes += list_size;
+            trace("  call display list, %u bytes\n", list_size);
+            if(depth > 0) {
+                // the GPU can't call a display list from one
+                fprintf(stderr, "host: display list called from a display list\n");
+                break;
+            }
+            execute(list, list_size, depth + 1);
+            break;
+        }
+        case OP_INV_VTX_CACHE:
+            counters.state_changes++;
+            trace("  invalidate vertex cache\n");
+            break;
+        case OP_SCISSOR:
+            for(int i = 0; i < 4; i++) gpu.scissor[i] = reader.get<u16>();
+            counters.state_changes++;
+            trace("  scissor %u %u %u %u\n", gpu.scissor[0], gpu.scissor[1], gpu.scissor[2], gpu.scissor[3]);
+            break;
+        case OP_Z_MODE:
+            gpu.z_enable = reader.get<u8>();
+            gpu.z_func = reader.get<u8>();
+            gpu.z_update = reader.get<u8>();
+            counters.state_changes++;
+            trace("  z mode %u %u %u\n", gpu.z_enable, gpu.z_func, gpu.z_update);
+            break;
+        case OP_Z_COMP_LOC:
+            gpu.z_before_tex = reader.get<u8>();
+            counters.state_changes++;
+            trace("  z before texturing %u\n", gpu.z_before_tex);
+            break;
+        case OP_BLEND_MODE:
+            gpu.blend_mode = reader.get<u8>();
+            gpu.blend_src = reader.get<u8>();
+            gpu.blend_dst = reader.get<u8>();
+            gpu.blend_op = reader.get<u8>();
+            counters.state_changes++;
+            trace("  blend mode %u %u %u\n", gpu.blend_mode, gpu.blend_src, gpu.blend_dst);
+            break;
+        case OP_ALPHA_COMPARE:
+            gpu.alpha_comp0 = reader.get<u8>();
+            gpu.alpha_ref0 = reader.get<u8>();
+            gpu.alpha_op = reader.get<u8>();
+            gpu.alpha_comp1 = reader.get<u8>();
+            gpu.alpha_ref1 = reader.get<u8>();
+            counters.state_changes++;
+            trace("  alpha compare %u %u\n", gpu.alpha_comp0, gpu.alpha_ref0);
+            break;
+        case OP_COLOR_UPDATE:
+            gpu.color_update = reader.get<u8>();
+            counters.state_changes++;
+            trace("  color update %u\n", gpu.color_update);
+            break;
+        case OP_ALPHA_UPDATE:
+            gpu.alpha_update = reader.get<u8>();
+            counters.state_changes++;
+            trace("  alpha update %u\n", gpu.alpha_update);
+            break;
+        case OP_TEV_OP:
+            reader.get<u8>();
+            gpu.tev_op = reader.get<u8>();
+            counters.state_changes++;
+            trace("  tev op %u\n", gpu.tev_op);
+            break;
+        case OP_OTHER: {
+            u8 which = reader.get<u8>();
+            u32 value = reader.get<u32>();
+            counters.state_changes++;
+            if(which == OTHER_DISP_COPY_DST) {
+                trace("  %s %u %u\n", other_names[which], value >> 16, value & 0xffff);
+            } else {
+                trace("  %s %u\n", which < sizeof(other_names) / sizeof(other_names[0]) ? other_names[which] : "unknown", value);
+            }
+            break;
+        }
+        case OP_TEXTURE: {
+            u8 map = reader.get<u8>() & 7;
+            reader.get(&gpu.textures[map], sizeof(GXTexObj));
+            counters.texture_loads++;
+            const GXTexObj &texture = gpu.textures[map];
+            trace("  texture %u: %ux%u format %u\n", map, texture.width, texture.height, texture.format);
+            break;
+        }
+        case OP_TLUT: {
+            u8 name = reader.get<u8>() & 7;
+            gpu.tlut_formats[name] = reader.get<u8>();
+            u16 entries = reader.get<u16>();
+            const u16* data = reader.get<const u16*>();
+            if(entries > 256) entries = 256;
+            if(data != NULL) memcpy(gpu.tluts[name], data, entries * sizeof(u16));
+            counters.texture_loads++;
+            trace("  tlut %u, %u entries\n", name, entries);
+            break;
+        }
+        case OP_INV_TEX:
+            counters.state_changes++;
+            trace("  invalidate textures\n");
+            break;
+        case OP_COPY_CLEAR:
+            gpu.clear_color = reader.get<GXColor>();
+            gpu.clear_z = reader.get<u32>();
+            counters.state_changes++;
+            trace("  copy clear color %02x%02x%02x\n", gpu.clear_color.r, gpu.clear_color.g, gpu.clear_color.b);
+            break;
+        case OP_DISP_COPY_SRC:
+            for(int i = 0; i < 4; i++) gpu.disp_copy_src[i] = reader.get<u16>();
+            counters.state_changes++;
+            trace("  display copy source %u %u %u %u\n", gpu.disp_copy_src[0], gpu.disp_copy_src[1],
+                    gpu.disp_copy_src[2], gpu.disp_copy_src[3]);
+            break;
+        case OP_TEX_COPY_SRC:
+            for(int i = 0; i < 4; i++) gpu.tex_copy_src[i] = reader.get<u16>();
+            counters.state_changes++;
+            trace("  texture copy source %u %u %u %u\n", gpu.tex_copy_src[0], gpu.tex_copy_src[1],
+                    gpu.tex_copy_src[2], gpu.tex_copy_src[3]);
+            break;
+        case OP_TEX_COPY_DST:
+            gpu.tex_copy_dst[0] = reader.get<u16>();
+            gpu.tex_copy_dst[1] = reader.get<u16>();
+            gpu.tex_copy_format = reader.get<u32>();
+            counters.state_changes++;
+            trace("  texture copy destination %ux%u format %u\n", gpu.tex_copy_dst[0], gpu.tex_copy_dst[1], gpu.tex_copy_format);
+            break;
+        case OP_COPY_TEX: {
+            bool clear = reader.get<u8>();
+            void* dest = reader.get<void*>();
+            counters.efb_copies++;
+            trace("  copy to texture%s\n", clear ? ", clearing" : "");
+            if(config.rasterize) raster_copy_tex(gpu, dest, clear);
+            break;
+        }
+        case OP_COPY_DISP: {
+            bool clear = reader.get<u8>();
+            trace("  copy to display%s\n", clear ? ", clearing" : "");
+            end_frame(clear);
+            break;
+        }
+        case OP_DRAW_SYNC: {
+            u16 token = reader.get<u16>();
+            trace("  draw sync %u\n", token);
+            recorder.draw_sync_token = token;
+            run_draw_sync_callback(token);
+            break;
+        }
+        case OP_DRAW_DONE:
+            trace("  draw done\n");
+            break;
+        case OP_PIX_SYNC:
+            trace("  pixel sync\n");
+            break;
+        default:
+            fprintf(stderr, "host: unknown command %02x\n", opcode);
+            reader.overrun = true;
+            break;
+    }
+}
+
+static void execute(const u8* data, u32 size, int depth) {
+    Reader reader = { data, size, 0, false };
+    while(reader.offset < reader.size && !reader.overrun) {
+        u32 start = reader.offset;
+        execute_command(reader, depth);
+        if(depth == 0) counters.fifo_bytes += reader.offset - start;
+    }
+    if(reader.overrun) {
+        fprintf(stderr, "host: command stream ended in the middle of a command\n");
+    }
+}
+
+void execute_fifo() {
+    if(recorder.fifo.empty()) return;
+    // callbacks may send more, which waits for the next time
+    std::vector<u8> fifo;
+    fifo.swap(recorder.fifo);
+    execute(fifo.data(), fifo.size(), 0);
+}
+
+u32 frames_copied() {
+    return frames;
+}
+
+void finish() {
+    execute_fifo();
+    u32 measured = frames > 1 ? frames - 1 : 1;
+    printf("host: %u frames, averages per frame:\n", frames > 0 ? frames - 1 : 0);
+    printf("  %10.0f bytes sent, %.0f of them from display lists\n",
+            (double)totals.fifo_bytes / measured + (double)totals.list_bytes / measured,
+            (double)totals.list_bytes / measured);
+    printf("  %10.1f draw calls, %.0f vertices\n", (double)totals.draw_calls / measured,
+            (double)totals.vertices / measured);
+    printf("  %10.1f display list calls\n", (double)totals.list_calls / measured);
+    printf("  %10.1f quads per draw call drawing quads\n",
+            totals.quad_draws > 0 ? (double)totals.quads / totals.quad_draws : 0.0);
+    printf("  %10.1f state changes, %.1f matrix loads, %.1f texture loads\n",
+            (double)totals.state_changes / measured, (double)totals.matrix_loads / measured,
+            (double)totals.texture_loads / measured);
+    printf("  %10.1f copies into textures\n", (double)totals.efb_copies / measured);
+    if(config.trace != NULL) fclose(config.trace);
+    if(config.stats != NULL) fclose(config.stats);
+    fflush(stdout);
+}
+
+}
+
+using namespace host;
+
+static void send_other(OtherState which, u32 value) {
+    recorder.put((u8)OP_OTHER);
+    recorder.put((u8)which);
+    recorder.put(value);
+}
+
+static void send_matrix(u32 row, const f32* rows, int count) {
+    recorder.put((u8)OP_MATRIX);
+    recorder.put((u8)row);
+    recorder.put((u8)count);
+    recorder.put(rows, count * 4 * sizeof(f32));
+}
+
+extern "C" {
+
+void GX_Init(void* fifo, u32 size) {
+    recorder.reset();
+    gpu.reset();
+    counters.reset();
+    totals.reset();
+    raster_setup(640, 528);
+}
+
+void GX_Flush(void) {
+    execute_fifo();
+}
+
+void GX_DrawDone(void) {
+    recorder.put((u8)OP_DRAW_DONE);
+    execute_fifo();
+}
+
+void GX_SetDrawDone(void) {
+    recorder.put((u8)OP_DRAW_DONE);
+}
+
+void GX_WaitDrawDone(void) {
+    execute_fifo();
+}
+
+void GX_SetDrawSync(u16 token) {
+    recorder.put((u8)OP_DRAW_SYNC);
+    recorder.put(token);
+}
+
+u16 GX_GetDrawSync(void) {
+    execute_fifo();
+    return recorder.draw_sync_token;
+}
+
+GXDrawDoneCallback GX_SetDrawDoneCallback(GXDrawDoneCallback callback) {
+    return NULL;
+}
+
+GXDrawSyncCallback GX_SetDrawSyncCallback(GXDrawSyncCallback callback) {
+    GXDrawSyncCallback previous = recorder.draw_sync_callback;
+    recorder.draw_sync_callback = callback;
+    return previous;
+}
+
+void GX_PixModeSync(void) {
+    recorder.put((u8)OP_PIX_SYNC);
+}
+
+void GX_SetViewport(f32 x, f32 y, f32 width, f32 height, f32 near, f32 far) {
+    f32 viewport[6] = { x, y, width, height, near, far };
+    recorder.put((u8)OP_VIEWPORT);
+    recorder.put(viewport, sizeof(viewport));
+}
+
+void GX_SetScissor(u32 x, u32 y, u32 width, u32 height) {
+    recorder.put((u8)OP_SCISSOR);
+    recorder.put((u16)x);
+    recorder.put((u16)y);
+    recorder.put((u16)width);
+    recorder.put((u16)height);
+}
+
+f32 GX_GetYScaleFactor(u16 efb_height, u16 xfb_height) {
+    return (f32)xfb_height / efb_height;
+}
+
+u32 GX_SetDispCopyYScale(f32 scale) {
+    // the host EFB is always copied one to one
+    return 480;
+}
+
+void GX_SetDispCopySrc(u16 left, u16 top, u16 width, u16 height) {
+    recorder.put((u8)OP_DISP_COPY_SRC);
+    recorder.put(left);
+    recorder.put(top);
+    recorder.put(width);
+    recorder.put(height);
+}
+
+void GX_SetDispCopyDst(u16 width, u16 height) {
+    send_other(OTHER_DISP_COPY_DST, width << 16 | height);
+}
+
+void GX_SetCopyFilter(u8 aa, u8 sample_pattern[12][2], u8 vf, u8* vfilter) {
+    send_other(OTHER_COPY_FILTER, vf);
+}
+
+void GX_SetFieldMode(u8 field_mode, u8 half_aspect) {
+    send_other(OTHER_FIELD_MODE, field_mode);
+}
+
+void GX_SetPixelFmt(u8 pixel_format, u8 z_format) {
+    send_other(OTHER_PIXEL_FORMAT, pixel_format);
+}
+
+void GX_SetDispCopyGamma(u8 gamma) {
+    send_other(OTHER_DISP_COPY_GAMMA, gamma);
+}
+
+void GX_SetCopyClear(GXColor color, u32 z) {
+    recorder.put((u8)OP_COPY_CLEAR);
+    recorder.put(color);
+    recorder.put(z);
+}
+
+void GX_CopyDisp(void* dest, u8 clear) {
+    recorder.put((u8)OP_COPY_DISP);
+    recorder.put(clear);
+}
+
+void GX_SetTexCopySrc(u16 left, u16 top, u16 width, u16 height) {
+    recorder.put((u8)OP_TEX_COPY_SRC);
+    recorder.put(left);
+    recorder.put(top);
+    recorder.put(width);
+    recorder.put(height);
+}
+
+void GX_SetTexCopyDst(u16 width, u16 height, u32 format, u8 mipmap) {
+    recorder.put((u8)OP_TEX_COPY_DST);
+    recorder.put(width);
+    recorder.put(height);
+    recorder.put(format);
+}
+
+void GX_CopyTex(void* dest, u8 clear) {
+    recorder.put((u8)OP_COPY_TEX);
+    recorder.put(clear);
+    recorder.put(dest);
+}
+
+void GX_SetCullMode(u8 mode) {
+    send_other(OTHER_CULL_MODE, mode);
+}
+
+void GX_SetClipMode(u8 mode) {
+    send_other(OTHER_CLIP_MODE, mode);
+}
+
+void GX_SetNumChans(u8 count) {
+    send_other(OTHER_NUM_CHANS, count);
+}
+
+void GX_SetNumTexGens(u32 count) {
+    send_other(OTHER_NUM_TEXGENS, count);
+}
+
+void GX_SetTevOp(u8 stage, u8 mode) {
+    recorder.put((u8)OP_TEV_OP);
+    recorder.put(stage);
+    recorder.put(mode);
+}
+
+void GX_SetTevOrder(u8 stage, u8 coord, u32 map, u8 color) {
+    send_other(OTHER_TEV_ORDER, map);
+}
+
+void GX_SetTexCoordGen(u16 coord, u32 type, u32 source, u32 matrix) {
+    // only the first texture coordinate is emulated
+    if(coord != GX_TEXCOORD0) return;
+    recorder.put((u8)OP_TEXGEN);
+    recorder.put((u8)type);
+    recorder.put((u8)matrix);
+}
+
+void GX_SetZMode(u8 enable, u8 func, u8 update) {
+    recorder.put((u8)OP_Z_MODE);
+    recorder.put(enable);
+    recorder.put(func);
+    recorder.put(update);
+}
+
+void GX_SetZCompLoc(u8 before_tex) {
+    recorder.put((u8)OP_Z_COMP_LOC);
+    recorder.put(before_tex);
+}
+
+void GX_SetBlendMode(u8 mode, u8 src, u8 dst, u8 op) {
+    recorder.put((u8)OP_BLEND_MODE);
+    recorder.put(mode);
+    recorder.put(src);
+    recorder.put(dst);
+    recorder.put(op);
+}
+
+void GX_SetAlphaUpdate(u8 enable) {
+    recorder.put((u8)OP_ALPHA_UPDATE);
+    recorder.put(enable);
+}
+
+void GX_SetColorUpdate(u8 enable) {
+    recorder.put((u8)OP_COLOR_UPDATE);
+    recorder.put(enable);
+}
+
+void GX_SetAlphaCompare(u8 comp0, u8 ref0, u8 op, u8 comp1, u8 ref1) {
+    recorder.put((u8)OP_ALPHA_COMPARE);
+    recorder.put(comp0);
+    recorder.put(ref0);
+    recorder.put(op);
+    recorder.put(comp1);
+    recorder.put(ref1);
+}
+
+void GX_LoadProjectionMtx(Mtx44 matrix, u8 type) {
+    recorder.put((u8)OP_PROJECTION);
+    recorder.put(type);
+    recorder.put(matrix, sizeof(Mtx44));
+}
+
+void GX_LoadPosMtxImm(Mtx matrix, u32 index) {
+    send_matrix(index, &matrix[0][0], 3);
+}
+
+void GX_LoadTexMtxImm(Mtx matrix, u32 index, u8 type) {
+    send_matrix(index, &matrix[0][0], type == GX_MTX2x4 ? 2 : 3);
+}
+
+void GX_SetVtxAttrFmt(u8 format, u32 attribute, u32 count, u32 type, u32 frac) {
+    VertexFormat &vertex_format = recorder.formats[format & 7];
+    if(attribute == GX_VA_POS) {
+        vertex_format.pos_count = count;
+        vertex_format.pos_type = type;
+        vertex_format.pos_frac = frac;
+    } else if(attribute == GX_VA_TEX0) {
+        vertex_format.tex_count = count;
+        vertex_format.tex_type = type;
+        vertex_format.tex_frac = frac;
+    } else {
+        // the game only sends positions and one texture coordinate
+        return;
+    }
+    recorder.formats_dirty |= 1 << (format & 7);
+}
+
+void GX_ClearVtxDesc(void) {
+    memset(recorder.vtx_desc, 0, sizeof(recorder.vtx_desc));
+    recorder.desc_dirty = true;
+}
+
+void GX_SetVtxDesc(u8 attribute, u8 type) {
+    if(attribute >= GX_VA_MAXATTR) return;
+    recorder.vtx_desc[attribute] = type;
+    recorder.desc_dirty = true;
+}
+
+void GX_SetArray(u32 attribute, void* data, u8 stride) {
+    recorder.put((u8)OP_ARRAY);
+    recorder.put((u8)attribute);
+    recorder.put(stride);
+    recorder.put((const u8*)data);
+}
+
+void GX_InvVtxCache(void) {
+    recorder.put((u8)OP_INV_VTX_CACHE);
+}
+
+void GX_Begin(u8 primitive, u8 format, u16 count) {
+    recorder.send_dirty_state();
+    recorder.put((u8)(primitive | (format & 7)));
+    recorder.put(count);
+}
+
+void GX_End(void) {
+}
+
+void GX_Position3f32(f32 x, f32 y, f32 z) {
+    f32 position[3] = { x, y, z };
+    recorder.put(position, sizeof(position));
+}
+
+void GX_Position2f32(f32 x, f32 y) {
+    f32 position[2] = { x, y };
+    recorder.put(position, sizeof(position));
+}
+
+void GX_Position3s16(s16 x, s16 y, s16 z) {
+    s16 position[3] = { x, y, z };
+    recorder.put(position, sizeof(position));
+}
+
+void GX_Position2s16(s16 x, s16 y) {
+    s16 position[2] = { x, y };
+    recorder.put(position, sizeof(position));
+}
+
+void GX_Position1x8(u8 index) {
+    recorder.put(index);
+}
+
+void GX_Position1x16(u16 index) {
+    recorder.put(index);
+}
+
+void GX_TexCoord2f32(f32 s, f32 t) {
+    f32 texcoord[2] = { s, t };
+    recorder.put(texcoord, sizeof(texcoord));
+}
+
+void GX_TexCoord2u16(u16 s, u16 t) {
+    u16 texcoord[2] = { s, t };
+    recorder.put(texcoord, sizeof(texcoord));
+}
+
+void GX_TexCoord2u8(u8 s, u8 t) {
+    u8 texcoord[2] = { s, t };
+    recorder.put(texcoord, sizeof(texcoord));
+}
+
+void GX_TexCoord1x8(u8 index) {
+    recorder.put(index);
+}
+
+void GX_TexCoord1x16(u16 index) {
+    recorder.put(index);
+}
+
+void GX_MatrixIndex1x8(u8 index) {
+    recorder.put(index);
+}
+
+void GX_BeginDispList(void* list, u32 size) {
+    // whatever changed before the list belongs to the main FIFO
+    recorder.send_dirty_state();
+    recorder.list = (u8*)list;
+    recorder.list_capacity = size;
+    recorder.list_size = 0;
+    recorder.list_overflow = false;
+}
+
+u32 GX_EndDispList(void) {
+    while(recorder.list_size % 32 != 0 && !recorder.list_overflow) {
+        recorder.put((u8)OP_NOP);
+    }
+    u32 size = recorder.list_overflow ? 0 : recorder.list_size;
+    recorder.list = NULL;
+    return size;
+}
+
+void GX_CallDispList(void* list, u32 size) {
+    recorder.send_dirty_state();
+    recorder.put((u8)OP_CALL);
+    recorder.put((const u8*)list);
+    recorder.put(size);
+}
+
+u32 GX_GetTexBufferSize(u16 width, u16 height, u32 format, u8 mipmap, u8 max_lod) {
+    int block_width = 4, block_height = 4, block_bytes = 32;
+    switch(format) {
+        case GX_TF_I4: case GX_TF_CI4: case GX_TF_CMPR:
+            block_width = 8;
+            block_height = 8;
+            break;
+        case GX_TF_I8: case GX_TF_IA4: case GX_TF_CI8:
+            block_width = 8;
+            break;
+        case GX_TF_RGBA8:
+            block_bytes = 64;
+            break;
+        default:
+            break;
+    }
+    u32 blocks_x = (width + block_width - 1) / block_width;
+    u32 blocks_y = (height + block_height - 1) / block_height;
+    return blocks_x * blocks_y * block_bytes;
+}
+
+void GX_InitTexObj(GXTexObj* obj, void* data, u16 width, u16 height, u8 format, u8 wrap_s, u8 wrap_t, u8 mipmap) {
+    memset(obj, 0, sizeof(*obj));
+    obj->data = data;
+    obj->width = width;
+    obj->height = height;
+    obj->format = format;
+    obj->wrap_s = wrap_s;
+    obj->wrap_t = wrap_t;
+    obj->mipmap = mipmap;
+    obj->min_filter = GX_LINEAR;
+    obj->mag_filter = GX_LINEAR;
+}
+
+void GX_InitTexObjCI(GXTexObj* obj, void* data, u16 width, u16 height, u8 format, u8 wrap_s, u8 wrap_t, u8 mipmap, u32 tlut) {
+    GX_InitTexObj(obj, data, width, height, format, wrap_s, wrap_t, mipmap);
+    obj->tlut = tlut;
+}
+
+void GX_InitTexObjFilterMode(GXTexObj* obj, u8 min_filter, u8 mag_filter) {
+    obj->min_filter = min_filter;
+    obj->mag_filter = mag_filter;
+}
+
+void GX_InitTlutObj(GXTlutObj* obj, void* data, u8 format, u16 entries) {
+    obj->data = data;
+    obj->format = format;
+    obj->entries = entries;
+}
+
+void GX_LoadTexObj(GXTexObj* obj, u8 map) {
+    recorder.put((u8)OP_TEXTURE);
+    recorder.put(map);
+    recorder.put(*obj);
+}
+
+void GX_LoadTlut(GXTlutObj* obj, u32 name) {
+    recorder.put((u8)OP_TLUT);
+    recorder.put((u8)name);
+    recorder.put(obj->format);
+    recorder.put(obj->entries);
+    recorder.put((const u16*)obj->data);
+}
+
+void GX_InvalidateTexAll(void) {
+    recorder.put((u8)OP_INV_TEX);
+}
+
+}
+
+void host::run_draw_sync_callback(u16 token) {
+    if(recorder.draw_sync_callback != NULL) recorder.draw_sync_callback(token);
+}
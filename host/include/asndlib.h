@@ -0,0 +1,16 @@
+/* Audio is silent on the host */
+#ifndef __HOST_ASNDLIB_H__
+#define __HOST_ASNDLIB_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ASND_Init(void);
+void ASND_End(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+/* The music isn't embedded in the host build, audio is silent anyway */
+#ifndef __HOST_FAIRY_PATH_OGG_H__
+#define __HOST_FAIRY_PATH_OGG_H__
+
+#include <gccore.h>
+
+extern const u8 fairy_path_ogg[];
+extern const u32 fairy_path_ogg_size;
+
+#endif
@@ -0,0 +1,390 @@
+/* The part of libogc the game uses, for building it on the host. GX,
+ * VIDEO and PAD are backed by the recording shim in host/, the rest is
+ * plain C. Values match libogc so the game code doesn't change. */
+#ifndef __HOST_GCCORE_H__
+#define __HOST_GCCORE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef float f32;
+typedef double f64;
+typedef int BOOL;
+typedef volatile u8 vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+
+#define FALSE 0
+#define TRUE 1
+#define ATTRIBUTE_ALIGN(v) __attribute__((aligned(v)))
+#define MEM_K0_TO_K1(x) ((void*)(x))
+
+typedef f32 Mtx[3][4];
+typedef f32 Mtx44[4][4];
+typedef f32 (*MtxP)[4];
+
+typedef struct {
+    f32 x, y, z;
+} guVector;
+
+typedef struct {
+    u8 r, g, b, a;
+} GXColor;
+
+/* Texture objects only live on the CPU until they are loaded, so the
+ * shim keeps them readable instead of packing them into registers */
+typedef struct {
+    void* data;
+    u16 width;
+    u16 height;
+    u8 format;
+    u8 wrap_s;
+    u8 wrap_t;
+    u8 mipmap;
+    u8 min_filter;
+    u8 mag_filter;
+    u32 tlut;
+} GXTexObj;
+
+typedef struct {
+    void* data;
+    u8 format;
+    u16 entries;
+} GXTlutObj;
+
+typedef struct {
+    u32 viTVMode;
+    u16 fbWidth;
+    u16 efbHeight;
+    u16 xfbHeight;
+    u16 viXOrigin;
+    u16 viYOrigin;
+    u16 viWidth;
+    u16 viHeight;
+    u32 xfbMode;
+    u8 field_rendering;
+    u8 aa;
+    u8 sample_pattern[12][2];
+    u8 vfilter[7];
+} GXRModeObj;
+
+#define VI_INTERLACE 0
+#define VI_NON_INTERLACE 1
+#define VI_DISPLAY_PIX_SZ 2
+
+#define GX_FALSE 0
+#define GX_TRUE 1
+#define GX_DISABLE 0
+#define GX_ENABLE 1
+
+#define GX_VTXFMT0 0
+#define GX_VTXFMT1 1
+#define GX_VTXFMT2 2
+#define GX_VTXFMT3 3
+#define GX_VTXFMT4 4
+#define GX_VTXFMT5 5
+#define GX_VTXFMT6 6
+#define GX_VTXFMT7 7
+#define GX_MAXVTXFMT 8
+
+#define GX_VA_PTNMTXIDX 0
+#define GX_VA_TEX0MTXIDX 1
+#define GX_VA_TEX1MTXIDX 2
+#define GX_VA_TEX2MTXIDX 3
+#define GX_VA_TEX3MTXIDX 4
+#define GX_VA_TEX4MTXIDX 5
+#define GX_VA_TEX5MTXIDX 6
+#define GX_VA_TEX6MTXIDX 7
+#define GX_VA_TEX7MTXIDX 8
+#define GX_VA_POS 9
+#define GX_VA_NRM 10
+#define GX_VA_CLR0 11
+#define GX_VA_CLR1 12
+#define GX_VA_TEX0 13
+#define GX_VA_TEX1 14
+#define GX_VA_MAXATTR 26
+#define GX_VA_NULL 0xff
+
+#define GX_NONE 0
+#define GX_DIRECT 1
+#define GX_INDEX8 2
+#define GX_INDEX16 3
+
+#define GX_POS_XY 0
+#define GX_POS_XYZ 1
+#define GX_TEX_S 0
+#define GX_TEX_ST 1
+
+#define GX_U8 0
+#define GX_S8 1
+#define GX_U16 2
+#define GX_S16 3
+#define GX_F32 4
+
+#define GX_POINTS 0xb8
+#define GX_LINES 0xa8
+#define GX_TRIANGLES 0x90
+#define GX_TRIANGLESTRIP 0x98
+#define GX_TRIANGLEFAN 0xa0
+#define GX_QUADS 0x80
+
+#define GX_PNMTX0 0
+#define GX_PNMTX1 3
+#define GX_PNMTX2 6
+#define GX_PNMTX3 9
+#define GX_PNMTX4 12
+#define GX_PNMTX5 15
+#define GX_PNMTX6 18
+#define GX_PNMTX7 21
+#define GX_PNMTX8 24
+#define GX_PNMTX9 27
+#define GX_TEXMTX0 30
+#define GX_TEXMTX1 33
+#define GX_TEXMTX2 36
+#define GX_TEXMTX3 39
+#define GX_IDENTITY 60
+
+#define GX_MTX3x4 0
+#define GX_MTX2x4 1
+#define GX_TG_MTX3x4 0
+#define GX_TG_MTX2x4 1
+
+#define GX_TG_POS 0
+#define GX_TG_NRM 1
+#define GX_TG_BINRM 2
+#define GX_TG_TANGENT 3
+#define GX_TG_TEX0 4
+
+#define GX_TEXCOORD0 0
+#define GX_TEXCOORD1 1
+#define GX_TEXCOORDNULL 0xff
+#define GX_TEXMAP0 0
+#define GX_TEXMAP1 1
+#define GX_TEXMAP_NULL 0xff
+#define GX_TEVSTAGE0 0
+#define GX_TEVSTAGE1 1
+#define GX_COLOR0A0 4
+#define GX_COLORNULL 0xff
+
+#define GX_MODULATE 0
+#define GX_DECAL 1
+#define GX_BLEND 2
+#define GX_REPLACE 3
+#define GX_PASSCLR 4
+
+#define GX_NEVER 0
+#define GX_LESS 1
+#define GX_EQUAL 2
+#define GX_LEQUAL 3
+#define GX_GREATER 4
+#define GX_NEQUAL 5
+#define GX_GEQUAL 6
+#define GX_ALWAYS 7
+
+#define GX_BM_NONE 0
+#define GX_BM_BLEND 1
+#define GX_BM_LOGIC 2
+#define GX_BM_SUBTRACT 3
+#define GX_BL_ZERO 0
+#define GX_BL_ONE 1
+#define GX_BL_SRCCLR 2
+#define GX_BL_INVSRCCLR 3
+#define GX_BL_SRCALPHA 4
+#define GX_BL_INVSRCALPHA 5
+#define GX_BL_DSTALPHA 6
+#define GX_BL_INVDSTALPHA 7
+#define GX_LO_CLEAR 0
+#define GX_LO_SET 15
+#define GX_AOP_AND 0
+#define GX_AOP_OR 1
+
+#define GX_CULL_NONE 0
+#define GX_PF_RGB8_Z24 0
+#define GX_PF_RGB565_Z16 2
+#define GX_ZC_LINEAR 0
+#define GX_GM_1_0 0
+#define GX_PERSPECTIVE 0
+#define GX_ORTHOGRAPHIC 1
+#define GX_CLIP_ENABLE 0
+#define GX_CLIP_DISABLE 1
+
+#define GX_TF_I4 0
+#define GX_TF_I8 1
+#define GX_TF_IA4 2
+#define GX_TF_IA8 3
+#define GX_TF_RGB565 4
+#define GX_TF_RGB5A3 5
+#define GX_TF_RGBA8 6
+#define GX_TF_CI4 8
+#define GX_TF_CI8 9
+#define GX_TF_CMPR 14
+
+#define GX_CLAMP 0
+#define GX_REPEAT 1
+#define GX_MIRROR 2
+#define GX_NEAR 0
+#define GX_LINEAR 1
+
+#define GX_TL_IA8 0
+#define GX_TL_RGB565 1
+#define GX_TL_RGB5A3 2
+#define GX_TLUT0 0
+#define GX_TLUT1 1
+#define GX_TLUT2 2
+#define GX_TLUT3 3
+#define GX_TLUT4 4
+#define GX_TLUT5 5
+#define GX_TLUT6 6
+#define GX_TLUT7 7
+#define GX_TLUT_256 1
+
+#define PAD_BUTTON_LEFT 0x0001
+#define PAD_BUTTON_RIGHT 0x0002
+#define PAD_BUTTON_DOWN 0x0004
+#define PAD_BUTTON_UP 0x0008
+#define PAD_TRIGGER_Z 0x0010
+#define PAD_TRIGGER_R 0x0020
+#define PAD_TRIGGER_L 0x0040
+#define PAD_BUTTON_A 0x0100
+#define PAD_BUTTON_B 0x0200
+#define PAD_BUTTON_X 0x0400
+#define PAD_BUTTON_Y 0x0800
+#define PAD_BUTTON_START 0x1000
+#define PAD_CHANMAX 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*GXDrawDoneCallback)(void);
+typedef void (*GXDrawSyncCallback)(u16 token);
+typedef void (*VIRetraceCallback)(u32 count);
+
+void GX_Init(void* fifo, u32 size);
+void GX_Flush(void);
+void GX_DrawDone(void);
+void GX_SetDrawDone(void);
+void GX_WaitDrawDone(void);
+void GX_SetDrawSync(u16 token);
+u16 GX_GetDrawSync(void);
+GXDrawDoneCallback GX_SetDrawDoneCallback(GXDrawDoneCallback callback);
+GXDrawSyncCallback GX_SetDrawSyncCallback(GXDrawSyncCallback callback);
+void GX_PixModeSync(void);
+
+void GX_SetViewport(f32 x, f32 y, f32 width, f32 height, f32 near, f32 far);
+void GX_SetScissor(u32 x, u32 y, u32 width, u32 height);
+f32 GX_GetYScaleFactor(u16 efb_height, u16 xfb_height);
+u32 GX_SetDispCopyYScale(f32 scale);
+void GX_SetDispCopySrc(u16 left, u16 top, u16 width, u16 height);
+void GX_SetDispCopyDst(u16 width, u16 height);
+void GX_SetCopyFilter(u8 aa, u8 sample_pattern[12][2], u8 vf, u8* vfilter);
+void GX_SetFieldMode(u8 field_mode, u8 half_aspect);
+void GX_SetPixelFmt(u8 pixel_format, u8 z_format);
+void GX_SetDispCopyGamma(u8 gamma);
+void GX_SetCopyClear(GXColor color, u32 z);
+void GX_CopyDisp(void* dest, u8 clear);
+void GX_SetTexCopySrc(u16 left, u16 top, u16 width, u16 height);
+void GX_SetTexCopyDst(u16 width, u16 height, u32 format, u8 mipmap);
+void GX_CopyTex(void* dest, u8 clear);
+
+void GX_SetCullMode(u8 mode);
+void GX_SetClipMode(u8 mode);
+void GX_SetNumChans(u8 count);
+void GX_SetNumTexGens(u32 count);
+void GX_SetTevOp(u8 stage, u8 mode);
+void GX_SetTevOrder(u8 stage, u8 coord, u32 map, u8 color);
+void GX_SetTexCoordGen(u16 coord, u32 type, u32 source, u32 matrix);
+void GX_SetZMode(u8 enable, u8 func, u8 update);
+void GX_SetZCompLoc(u8 before_tex);
+void GX_SetBlendMode(u8 mode, u8 src, u8 dst, u8 op);
+void GX_SetAlphaUpdate(u8 enable);
+void GX_SetColorUpdate(u8 enable);
+void GX_SetAlphaCompare(u8 comp0, u8 ref0, u8 op, u8 comp1, u8 ref1);
+
+void GX_LoadProjectionMtx(Mtx44 matrix, u8 type);
+void GX_LoadPosMtxImm(Mtx matrix, u32 index);
+void GX_LoadTexMtxImm(Mtx matrix, u32 index, u8 type);
+
+void GX_SetVtxAttrFmt(u8 format, u32 attribute, u32 count, u32 type, u32 frac);
+void GX_ClearVtxDesc(void);
+void GX_SetVtxDesc(u8 attribute, u8 type);
+void GX_SetArray(u32 attribute, void* data, u8 stride);
+void GX_InvVtxCache(void);
+
+void GX_Begin(u8 primitive, u8 format, u16 count);
+void GX_End(void);
+void GX_Position3f32(f32 x, f32 y, f32 z);
+void GX_Position2f32(f32 x, f32 y);
+void GX_Position3s16(s16 x, s16 y, s16 z);
+void GX_Position2s16(s16 x, s16 y);
+void GX_Position1x8(u8 index);
+void GX_Position1x16(u16 index);
+void GX_TexCoord2f32(f32 s, f32 t);
+void GX_TexCoord2u16(u16 s, u16 t);
+void GX_TexCoord2u8(u8 s, u8 t);
+void GX_TexCoord1x8(u8 index);
+void GX_TexCoord1x16(u16 index);
+void GX_MatrixIndex1x8(u8 index);
+
+void GX_BeginDispList(void* list, u32 size);
+u32 GX_EndDispList(void);
+void GX_CallDispList(void* list, u32 size);
+
+u32 GX_GetTexBufferSize(u16 width, u16 height, u32 format, u8 mipmap, u8 max_lod);
+void GX_InitTexObj(GXTexObj* obj, void* data, u16 width, u16 height, u8 format, u8 wrap_s, u8 wrap_t, u8 mipmap);
+void GX_InitTexObjCI(GXTexObj* obj, void* data, u16 width, u16 height, u8 format, u8 wrap_s, u8 wrap_t, u8 mipmap, u32 tlut);
+void GX_InitTexObjFilterMode(GXTexObj* obj, u8 min_filter, u8 mag_filter);
+void GX_InitTlutObj(GXTlutObj* obj, void* data, u8 format, u16 entries);
+void GX_LoadTexObj(GXTexObj* obj, u8 map);
+void GX_LoadTlut(GXTlutObj* obj, u32 name);
+void GX_InvalidateTexAll(void);
+
+void guOrtho(Mtx44 matrix, f32 top, f32 bottom, f32 left, f32 right, f32 near, f32 far);
+void guMtxIdentity(Mtx matrix);
+void guMtxCopy(Mtx src, Mtx dst);
+void guMtxConcat(Mtx a, Mtx b, Mtx ab);
+void guMtxTrans(Mtx matrix, f32 x, f32 y, f32 z);
+void guMtxTransApply(Mtx src, Mtx dst, f32 x, f32 y, f32 z);
+void guMtxScale(Mtx matrix, f32 x, f32 y, f32 z);
+void guMtxScaleApply(Mtx src, Mtx dst, f32 x, f32 y, f32 z);
+void guMtxRotRad(Mtx matrix, char axis, f32 radians);
+
+void DCFlushRange(void* start, u32 size);
+void DCInvalidateRange(void* start, u32 size);
+void DCStoreRange(void* start, u32 size);
+
+void VIDEO_Init(void);
+GXRModeObj* VIDEO_GetPreferredMode(GXRModeObj* mode);
+void VIDEO_Configure(GXRModeObj* mode);
+void VIDEO_SetNextFramebuffer(void* buffer);
+void VIDEO_SetBlack(BOOL black);
+void VIDEO_Flush(void);
+void VIDEO_WaitVSync(void);
+u32 VIDEO_GetRetraceCount(void);
+VIRetraceCallback VIDEO_SetPreRetraceCallback(VIRetraceCallback callback);
+VIRetraceCallback VIDEO_SetPostRetraceCallback(VIRetraceCallback callback);
+void* SYS_AllocateFramebuffer(GXRModeObj* mode);
+void console_init(void* framebuffer, int x, int y, int width, int height, int stride);
+
+u32 PAD_Init(void);
+u32 PAD_ScanPads(void);
+u16 PAD_ButtonsDown(int pad);
+u16 PAD_ButtonsUp(int pad);
+u16 PAD_ButtonsHeld(int pad);
+s8 PAD_StickX(int pad);
+s8 PAD_StickY(int pad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
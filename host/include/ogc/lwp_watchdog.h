@@ -0,0 +1,23 @@
+/* Time base of the host build, ticking at the rate of the Wii's */
+#ifndef __HOST_LWP_WATCHDOG_H__
+#define __HOST_LWP_WATCHDOG_H__
+
+#include <gccore.h>
+
+#define TB_TIMER_CLOCK 60750 // ticks a millisecond
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+u64 gettime(void);
+u32 diff_usec(u64 start, u64 end);
+u32 diff_msec(u64 start, u64 end);
+u64 ticks_to_microsecs(u64 ticks);
+u64 microsecs_to_ticks(u64 microsecs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef __HOST_TPL_H__
+#define __HOST_TPL_H__
+
+#include <gccore.h>
+
+#endif
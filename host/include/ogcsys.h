@@ -0,0 +1,6 @@
+#ifndef __HOST_OGCSYS_H__
+#define __HOST_OGCSYS_H__
+
+#include <gccore.h>
+
+#endif
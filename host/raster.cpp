@@ -0,0 +1,439 @@
+/* A software EFB for the host build, drawing what the command stream
+ * describes closely enough to compare frames against golden images.
+ * Only what the game uses is emulated: one texture, REPLACE or PASSCLR
+ * in the TEV, the z, alpha and blend state, and copies out of the EFB.
+ * Triangles are filled at pixel centers with a top-left rule. Edges are
+ * tested in integers on positions snapped to 1/16 pixel, like the GPU's
+ * own subpixel grid, so quads sharing an edge never overlap or leave
+ * gaps. */
+#include "shim.h"
+
+#include <math.h>
+#include <string.h>
+#include <zlib.h>
+#include <algorithm>
+
+namespace host {
+
+struct Color8 {
+    u8 r, g, b, a;
+};
+
+static int efb_width = 0;
+static int efb_height = 0;
+static std::vector<Color8> efb_color;
+static std::vector<u32> efb_depth;
+// the last display copy, what the PNG is written from
+static int display_width = 0;
+static int display_height = 0;
+static std::vector<Color8> display;
+
+void raster_setup(int width, int height) {
+    efb_width = width;
+    efb_height = height;
+    efb_color.assign(width * height, Color8 { 0, 0, 0, 0xff });
+    efb_depth.assign(width * height, 0x00ffffff);
+}
+
+static Color8 from_rgb565(u16 value) {
+    Color8 color;
+    color.r = (value >> 11) << 3 | (value >> 13);
+    color.g = ((value >> 5) & 0x3f) << 2 | ((value >> 9) & 3);
+    color.b = (value & 0x1f) << 3 | ((value >> 2) & 7);
+    color.a = 0xff;
+    return color;
+}
+
+static Color8 from_rgb5a3(u16 value) {
+    Color8 color;
+    if(value & 0x8000) {
+        color.r = ((value >> 10) & 0x1f) << 3 | ((value >> 12) & 7);
+        color.g = ((value >> 5) & 0x1f) << 3 | ((value >> 7) & 7);
+        color.b = (value & 0x1f) << 3 | ((value >> 2) & 7);
+        color.a = 0xff;
+    } else {
+        color.a = ((value >> 12) & 7) * 0x24 + ((value >> 12) & 7) / 2;
+        color.r = ((value >> 8) & 0xf) * 0x11;
+        color.g = ((value >> 4) & 0xf) * 0x11;
+        color.b = (value & 0xf) * 0x11;
+    }
+    return color;
+}
+
+static Color8 from_tlut(const GpuState &state, u32 tlut, u32 index) {
+    u16 value = state.tluts[tlut & 7][index & 0xff];
+    switch(state.tlut_formats[tlut & 7]) {
+        case GX_TL_RGB565: return from_rgb565(value);
+        case GX_TL_RGB5A3: return from_rgb5a3(value);
+        default: return Color8 { (u8)value, (u8)value, (u8)value, (u8)(value >> 8) };
+    }
+}
+
+/// Size of the blocks a format is tiled in, and bits per texel
+static void block_layout(u8 format, int &width, int &height, int &bits) {
+    switch(format) {
+        case GX_TF_I4: case GX_TF_CI4: case GX_TF_CMPR:
+            width = 8; height = 8; bits = 4;
+            break;
+        case GX_TF_I8: case GX_TF_IA4: case GX_TF_CI8:
+            width = 8; height = 4; bits = 8;
+            break;
+        case GX_TF_RGBA8:
+            width = 4; height = 4; bits = 32;
+            break;
+        default:
+            width = 4; height = 4; bits = 16;
+            break;
+    }
+}
+
+/// Reads one texel, x and y already wrapped into the texture. 16-bit
+/// texels are read in the byte order the CPU wrote them in.
+static Color8 fetch_texel(const GpuState &state, const GXTexObj &texture, int x, int y) {
+    int block_width, block_height, bits;
+    block_layout(texture.format, block_width, block_height, bits);
+    int blocks_x = (texture.width + block_width - 1) / block_width;
+    int block = (y / block_height) * blocks_x + x / block_width;
+    int index = (y % block_height) * block_width + x % block_width;
+    const u8* data = (const u8*)texture.data;
+    if(texture.format == GX_TF_RGBA8) {
+        const u8* texels = data + block * 64;
+        return Color8 { texels[index * 2 + 1], texels[32 + index * 2], texels[32 + index * 2 + 1], texels[index * 2] };
+    }
+    const u8* texels = data + block * (block_width * block_height * bits / 8);
+    u16 value16 = 0;
+    if(bits == 16) memcpy(&value16, texels + index * 2, 2);
+    u8 value8 = bits == 8 ? texels[index] : 0;
+    u8 value4 = bits == 4 ? (texels[index / 2] >> (index % 2 == 0 ? 4 : 0)) & 0xf : 0;
+    switch(texture.format) {
+        case GX_TF_I4: return Color8 { (u8)(value4 * 0x11), (u8)(value4 * 0x11), (u8)(value4 * 0x11), (u8)(value4 * 0x11) };
+        case GX_TF_I8: return Color8 { value8, value8, value8, value8 };
+        case GX_TF_IA4: {
+            u8 intensity = (value8 & 0xf) * 0x11;
+            return Color8 { intensity, intensity, intensity, (u8)((value8 >> 4) * 0x11) };
+        }
+        case GX_TF_IA8: return Color8 { (u8)value16, (u8)value16, (u8)value16, (u8)(value16 >> 8) };
+        case GX_TF_RGB565: return from_rgb565(value16);
+        case GX_TF_RGB5A3: return from_rgb5a3(value16);
+        case GX_TF_CI4: return from_tlut(state, texture.tlut, value4);
+        case GX_TF_CI8: return from_tlut(state, texture.tlut, value8);
+        default:
+            // compressed textures aren't decoded, they show up gray
+            return Color8 { 0x80, 0x80, 0x80, 0xff };
+    }
+}
+
+static int wrap(int value, int size, u8 mode) {
+    switch(mode) {
+        case GX_REPEAT:
+            value %= size;
+            return value < 0 ? value + size : value;
+        case GX_MIRROR: {
+            int period = value % (2 * size);
+            if(period < 0) period += 2 * size;
+            return period < size ? period : 2 * size - 1 - period;
+        }
+        default:
+            return value < 0 ? 0 : value >= size ? size - 1 : value;
+    }
+}
+
+static Color8 sample(const GpuState &state, f32 s, f32 t) {
+    const GXTexObj &texture = state.textures[GX_TEXMAP0];
+    if(texture.data == NULL || texture.width == 0 || texture.height == 0) {
+        return Color8 { 0xff, 0xff, 0xff, 0xff };
+    }
+    f32 x = s * texture.width;
+    f32 y = t * texture.height;
+    if(texture.mag_filter == GX_NEAR) {
+        int texel_x = wrap((int)floorf(x), texture.width, texture.wrap_s);
+        int texel_y = wrap((int)floorf(y), texture.height, texture.wrap_t);
+        return fetch_texel(state, texture, texel_x, texel_y);
+    }
+    x -= 0.5F;
+    y -= 0.5F;
+    int x0 = (int)floorf(x);
+    int y0 = (int)floorf(y);
+    f32 fx = x - x0;
+    f32 fy = y - y0;
+    Color8 corners[4];
+    for(int i = 0; i < 4; i++) {
+        int texel_x = wrap(x0 + (i & 1), texture.width, texture.wrap_s);
+        int texel_y = wrap(y0 + (i >> 1), texture.height, texture.wrap_t);
+        corners[i] = fetch_texel(state, texture, texel_x, texel_y);
+    }
+    f32 weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+    f32 channels[4] = { 0, 0, 0, 0 };
+    for(int i = 0; i < 4; i++) {
+        channels[0] += corners[i].r * weights[i];
+        channels[1] += corners[i].g * weights[i];
+        channels[2] += corners[i].b * weights[i];
+        channels[3] += corners[i].a * weights[i];
+    }
+    return Color8 { (u8)(channels[0] + 0.5F), (u8)(channels[1] + 0.5F), (u8)(channels[2] + 0.5F), (u8)(channels[3] + 0.5F) };
+}
+
+static bool compare(u8 func, u32 value, u32 reference) {
+    switch(func) {
+        case GX_NEVER: return false;
+        case GX_LESS: return value < reference;
+        case GX_EQUAL: return value == reference;
+        case GX_LEQUAL: return value <= reference;
+        case GX_GREATER: return value > reference;
+        case GX_NEQUAL: return value != reference;
+        case GX_GEQUAL: return value >= reference;
+        default: return true;
+    }
+}
+
+static bool alpha_passes(const GpuState &state, u8 alpha) {
+    bool first = compare(state.alpha_comp0, alpha, state.alpha_ref0);
+    bool second = compare(state.alpha_comp1, alpha, state.alpha_ref1);
+    return state.alpha_op == GX_AOP_OR ? first || second : first && second;
+}
+
+/// One blend factor for a channel, GX_BL_SRCCLR means the destination
+/// color when it's the source factor
+static f32 blend_factor(u8 factor, bool source, f32 src, f32 dst, f32 src_alpha, f32 dst_alpha) {
+    switch(factor) {
+        case GX_BL_ZERO: return 0.0F;
+        case GX_BL_ONE: return 1.0F;
+        case GX_BL_SRCCLR: return source ? dst : src;
+        case GX_BL_INVSRCCLR: return 1.0F - (source ? dst : src);
+        case GX_BL_SRCALPHA: return src_alpha;
+        case GX_BL_INVSRCALPHA: return 1.0F - src_alpha;
+        case GX_BL_DSTALPHA: return dst_alpha;
+        default: return 1.0F - dst_alpha;
+    }
+}
+
+static Color8 blend(const GpuState &state, Color8 src, Color8 dst) {
+    if(state.blend_mode == GX_BM_SUBTRACT) {
+        return Color8 { (u8)(dst.r > src.r ? dst.r - src.r : 0), (u8)(dst.g > src.g ? dst.g - src.g : 0),
+            (u8)(dst.b > src.b ? dst.b - src.b : 0), dst.a };
+    }
+    if(state.blend_mode != GX_BM_BLEND) return src;
+    f32 src_alpha = src.a / 255.0F;
+    f32 dst_alpha = dst.a / 255.0F;
+    u8 in[2][4] = { { src.r, src.g, src.b, src.a }, { dst.r, dst.g, dst.b, dst.a } };
+    u8 out[4];
+    for(int i = 0; i < 4; i++) {
+        f32 s = in[0][i] / 255.0F;
+        f32 d = in[1][i] / 255.0F;
+        f32 value = s * blend_factor(state.blend_src, true, s, d, src_alpha, dst_alpha) +
+            d * blend_factor(state.blend_dst, false, s, d, src_alpha, dst_alpha);
+        if(value > 1.0F) value = 1.0F;
+        out[i] = (u8)(value * 255.0F + 0.5F);
+    }
+    return Color8 { out[0], out[1], out[2], out[3] };
+}
+
+static void shade(const GpuState &state, int x, int y, f32 z, f32 s, f32 t) {
+    // outside the near and far planes is clipped
+    if(z < 0.0F || z > 1.0F) return;
+    int index = y * efb_width + x;
+    u32 depth = (u32)(z * 0x00ffffff + 0.5F);
+    bool z_passes = !state.z_enable || compare(state.z_func, depth, efb_depth[index]);
+    if(state.z_before_tex) {
+        if(!z_passes) return;
+        if(state.z_enable && state.z_update) efb_depth[index] = depth;
+    }
+    Color8 color = state.tev_op == GX_PASSCLR ? Color8 { 0xff, 0xff, 0xff, 0xff } : sample(state, s, t);
+    if(!alpha_passes(state, color.a)) return;
+    if(!state.z_before_tex) {
+        if(!z_passes) return;
+        if(state.z_enable && state.z_update) efb_depth[index] = depth;
+    }
+    Color8 &pixel = efb_color[index];
+    Color8 blended = blend(state, color, pixel);
+    if(state.color_update) {
+        pixel.r = blended.r;
+        pixel.g = blended.g;
+        pixel.b = blended.b;
+    }
+    if(state.alpha_update) pixel.a = blended.a;
+}
+
+#define SUBPIXEL_BITS 4 // positions are snapped to 1/16 pixel
+#define SUBPIXEL_HALF (1 << (SUBPIXEL_BITS - 1))
+
+/* A vertex position in subpixels */
+struct FixedPoint {
+    s64 x, y;
+};
+
+static FixedPoint snap(const ScreenVertex &vertex) {
+    return FixedPoint { (s64)llroundf(vertex.x * (1 << SUBPIXEL_BITS)), (s64)llroundf(vertex.y * (1 << SUBPIXEL_BITS)) };
+}
+
+/// Exact in integers, so both triangles sharing an edge agree on which
+/// side of it every pixel center is
+static s64 edge(const FixedPoint &a, const FixedPoint &b, s64 x, s64 y) {
+    return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+/// Whether pixels exactly on the edge from a to b belong to the triangle.
+/// The other triangle on that edge runs it from b to a, so exactly one
+/// of them owns it.
+static bool top_left(const FixedPoint &a, const FixedPoint &b) {
+    return (a.y == b.y && b.x < a.x) || b.y > a.y;
+}
+
+void raster_triangle(const GpuState &state, const ScreenVertex &a, const ScreenVertex &in_b, const ScreenVertex &in_c) {
+    FixedPoint fixed_a = snap(a);
+    FixedPoint fixed_b = snap(in_b);
+    FixedPoint fixed_c = snap(in_c);
+    s64 area = edge(fixed_a, fixed_b, fixed_c.x, fixed_c.y);
+    if(area == 0) return;
+    // wind every triangle the same way, there is no culling
+    const ScreenVertex &b = area > 0 ? in_b : in_c;
+    const ScreenVertex &c = area > 0 ? in_c : in_b;
+    if(area < 0) {
+        FixedPoint swap = fixed_b;
+        fixed_b = fixed_c;
+        fixed_c = swap;
+        area = -area;
+    }
+
+    // arithmetic shifts round down, negative positions included
+    s64 left = std::min(fixed_a.x, std::min(fixed_b.x, fixed_c.x)) >> SUBPIXEL_BITS;
+    s64 right = (std::max(fixed_a.x, std::max(fixed_b.x, fixed_c.x)) >> SUBPIXEL_BITS) + 1;
+    s64 top = std::min(fixed_a.y, std::min(fixed_b.y, fixed_c.y)) >> SUBPIXEL_BITS;
+    s64 bottom = (std::max(fixed_a.y, std::max(fixed_b.y, fixed_c.y)) >> SUBPIXEL_BITS) + 1;
+    left = std::max(left, (s64)state.scissor[0]);
+    top = std::max(top, (s64)state.scissor[1]);
+    right = std::min(right, (s64)(state.scissor[0] + state.scissor[2]));
+    bottom = std::min(bottom, (s64)(state.scissor[1] + state.scissor[3]));
+    right = std::min(right, (s64)efb_width);
+    bottom = std::min(bottom, (s64)efb_height);
+
+    // pixels on an edge the triangle doesn't own need to be inside by one
+    s64 bias_a = top_left(fixed_b, fixed_c) ? 0 : -1;
+    s64 bias_b = top_left(fixed_c, fixed_a) ? 0 : -1;
+    s64 bias_c = top_left(fixed_a, fixed_b) ? 0 : -1;
+    for(s64 y = top; y < bottom; y++) {
+        s64 center_y = (y << SUBPIXEL_BITS) + SUBPIXEL_HALF;
+        for(s64 x = left; x < right; x++) {
+            s64 center_x = (x << SUBPIXEL_BITS) + SUBPIXEL_HALF;
+            s64 w0 = edge(fixed_b, fixed_c, center_x, center_y);
+            s64 w1 = edge(fixed_c, fixed_a, center_x, center_y);
+            s64 w2 = edge(fixed_a, fixed_b, center_x, center_y);
+            if(w0 + bias_a < 0 || w1 + bias_b < 0 || w2 + bias_c < 0) continue;
+            f32 weight_a = (f32)w0 / area;
+            f32 weight_b = (f32)w1 / area;
+            f32 weight_c = (f32)w2 / area;
+            shade(state, x, y,
+                    a.z * weight_a + b.z * weight_b + c.z * weight_c,
+                    a.s * weight_a + b.s * weight_b + c.s * weight_c,
+                    a.t * weight_a + b.t * weight_b + c.t * weight_c);
+        }
+    }
+}
+
+static void clear_rect(const GpuState &state, int left, int top, int width, int height) {
+    for(int y = top; y < top + height && y < efb_height; y++) {
+        for(int x = left; x < left + width && x < efb_width; x++) {
+            efb_color[y * efb_width + x] = Color8 { state.clear_color.r, state.clear_color.g, state.clear_color.b, state.clear_color.a };
+            efb_depth[y * efb_width + x] = state.clear_z & 0x00ffffff;
+        }
+    }
+}
+
+void raster_copy_tex(const GpuState &state, void* dest, bool clear) {
+    int left = state.tex_copy_src[0];
+    int top = state.tex_copy_src[1];
+    int width = state.tex_copy_dst[0];
+    int height = state.tex_copy_dst[1];
+    u8 format = state.tex_copy_format;
+    if(format != GX_TF_RGB5A3 && format != GX_TF_RGBA8) format = GX_TF_RGB565;
+    int block_width, block_height, bits;
+    block_layout(format, block_width, block_height, bits);
+    int blocks_x = (width + block_width - 1) / block_width;
+    u8* data = (u8*)dest;
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            int source_x = left + x < efb_width ? left + x : efb_width - 1;
+            int source_y = top + y < efb_height ? top + y : efb_height - 1;
+            Color8 color = efb_color[source_y * efb_width + source_x];
+            int block = (y / block_height) * blocks_x + x / block_width;
+            int index = (y % block_height) * block_width + x % block_width;
+            if(format == GX_TF_RGBA8) {
+                u8* texels = data + block * 64;
+                texels[index * 2] = color.a;
+                texels[index * 2 + 1] = color.r;
+                texels[32 + index * 2] = color.g;
+                texels[32 + index * 2 + 1] = color.b;
+                continue;
+            }
+            u16 value;
+            if(format == GX_TF_RGB565) {
+                value = (color.r >> 3) << 11 | (color.g >> 2) << 5 | color.b >> 3;
+            } else {
+                value = 0x8000 | (color.r >> 3) << 10 | (color.g >> 3) << 5 | color.b >> 3;
+            }
+            memcpy(data + block * 32 + index * 2, &value, 2);
+        }
+    }
+    if(clear) clear_rect(state, left, top, width, height);
+}
+
+void raster_copy_disp(const GpuState &state, bool clear) {
+    int left = state.disp_copy_src[0];
+    int top = state.disp_copy_src[1];
+    display_width = state.disp_copy_src[2];
+    display_height = state.disp_copy_src[3];
+    display.resize(display_width * display_height);
+    for(int y = 0; y < display_height; y++) {
+        for(int x = 0; x < display_width; x++) {
+            bool inside = left + x < efb_width && top + y < efb_height;
+            display[y * display_width + x] = inside ? efb_color[(top + y) * efb_width + left + x] : Color8 { 0, 0, 0, 0xff };
+        }
+    }
+    if(clear) clear_rect(state, left, top, display_width, display_height);
+}
+
+static void write_chunk(FILE* file, const char* type, const u8* data, u32 size) {
+    u8 header[8] = { (u8)(size >> 24), (u8)(size >> 16), (u8)(size >> 8), (u8)size,
+        (u8)type[0], (u8)type[1], (u8)type[2], (u8)type[3] };
+    fwrite(header, 1, 8, file);
+    if(size > 0) fwrite(data, 1, size, file);
+    uLong crc = crc32(0, header + 4, 4);
+    if(size > 0) crc = crc32(crc, data, size);
+    u8 footer[4] = { (u8)(crc >> 24), (u8)(crc >> 16), (u8)(crc >> 8), (u8)crc };
+    fwrite(footer, 1, 4, file);
+}
+
+bool raster_write_png(const char* path) {
+    if(display_width == 0 || display_height == 0) return false;
+    // every row starts with filter type 0, no filtering
+    std::vector<u8> rows;
+    rows.reserve((display_width * 3 + 1) * display_height);
+    for(int y = 0; y < display_height; y++) {
+        rows.push_back(0);
+        for(int x = 0; x < display_width; x++) {
+            const Color8 &color = display[y * display_width + x];
+            rows.push_back(color.r);
+            rows.push_back(color.g);
+            rows.push_back(color.b);
+        }
+    }
+    uLongf compressed_size = compressBound(rows.size());
+    std::vector<u8> compressed(compressed_size);
+    if(compress2(compressed.data(), &compressed_size, rows.data(), rows.size(), 9) != Z_OK) return false;
+
+    FILE* file = fopen(path, "wb");
+    if(file == NULL) return false;
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    fwrite(signature, 1, 8, file);
+    u8 header[13] = {
+        (u8)(display_width >> 24), (u8)(display_width >> 16), (u8)(display_width >> 8), (u8)display_width,
+        (u8)(display_height >> 24), (u8)(display_height >> 16), (u8)(display_height >> 8), (u8)display_height,
+        8, 2, 0, 0, 0 // 8 bits a channel, RGB
+    };
+    write_chunk(file, "IHDR", header, sizeof(header));
+    write_chunk(file, "IDAT", compressed.data(), compressed_size);
+    write_chunk(file, "IEND", NULL, 0);
+    return fclose(file) == 0;
+}
+
+}
@@ -0,0 +1,112 @@
+/* Internals shared by the pieces of the host shim. Nothing in here is
+ * visible to the game, which only sees the libogc headers in include/. */
+#ifndef __HOST_SHIM_H__
+#define __HOST_SHIM_H__
+
+#include <gccore.h>
+#include <stdio.h>
+#include <vector>
+
+namespace host {
+
+/* Read from the environment once, before the game starts */
+struct Config {
+    u32 frames;                // frames to run before exiting
+    const char* snapshot_dir;  // where frames are written as PNG, NULL for none
+    std::vector<u32> snapshot_frames; // empty for only the last frame
+    bool rasterize;            // draw into the EFB at all, implied by snapshots
+    FILE* trace;               // every command of every frame, as text
+    bool trace_vertices;       // with every vertex too
+    FILE* stats;               // a CSV line per frame
+    u32 seed;                  // what time() returns, so every run is the same
+    bool real_time;            // gettime() follows the clock instead of the frames
+};
+
+extern Config config;
+
+void load_config();
+
+/* What the GPU did for one frame, counted as commands are executed so
+ * display lists count every time they are called */
+struct FrameCounters {
+    u64 fifo_bytes;    // sent by the CPU, display list calls included
+    u64 list_bytes;    // read from called display lists
+    u32 draw_calls;    // GX_Begin runs
+    u32 vertices;
+    u32 state_changes; // everything that isn't a draw, a matrix or a texture
+    u32 matrix_loads;
+    u32 texture_loads; // texture objects and TLUTs
+    u32 list_calls;
+    u32 efb_copies;    // into textures, display copies don't count
+    u32 quads;
+    u32 quad_draws;    // draw calls drawing quads, what a sprite batch flush sends
+    void reset();
+    void add(const FrameCounters &other);
+};
+
+/* Vertex attribute formats of one vertex format slot */
+struct VertexFormat {
+    u8 pos_count, pos_type, pos_frac;
+    u8 tex_count, tex_type, tex_frac;
+};
+
+struct Array {
+    const u8* data;
+    u8 stride;
+};
+
+/* Everything the command stream has set so far, as the GPU sees it */
+struct GpuState {
+    u8 vtx_desc[GX_VA_MAXATTR];
+    VertexFormat formats[GX_MAXVTXFMT];
+    Array arrays[GX_VA_MAXATTR];
+    f32 xf_rows[64][4]; // position and texture matrices, three or two rows each
+    Mtx44 projection;
+    f32 viewport[6];    // x, y, width, height, near, far
+    u32 scissor[4];     // x, y, width, height
+    u8 texgen_type;
+    u8 texgen_matrix;
+    u8 tev_op;
+    u8 z_enable, z_func, z_update;
+    u8 z_before_tex;
+    u8 blend_mode, blend_src, blend_dst, blend_op;
+    u8 alpha_comp0, alpha_ref0, alpha_op, alpha_comp1, alpha_ref1;
+    u8 color_update, alpha_update;
+    GXTexObj textures[8];
+    u16 tluts[8][256];
+    u8 tlut_formats[8];
+    GXColor clear_color;
+    u32 clear_z;
+    u16 disp_copy_src[4];
+    u16 tex_copy_src[4];
+    u16 tex_copy_dst[2];
+    u32 tex_copy_format;
+    void reset();
+};
+
+/* A vertex after transformation, in EFB pixels. z is 0 at the camera
+ * and 1 at the far plane. */
+struct ScreenVertex {
+    f32 x, y, z;
+    f32 s, t;
+};
+
+void raster_setup(int width, int height);
+void raster_triangle(const GpuState &state, const ScreenVertex &a, const ScreenVertex &b, const ScreenVertex &c);
+void raster_copy_tex(const GpuState &state, void* dest, bool clear);
+void raster_copy_disp(const GpuState &state, bool clear);
+bool raster_write_png(const char* path);
+
+/// Runs everything the CPU has sent, called wherever the game would
+/// wait for the GPU
+void execute_fifo();
+/// Display copies executed so far, the one at startup is frame 0
+u32 frames_copied();
+/// Prints the totals and closes the output files
+void finish();
+
+void run_draw_sync_callback(u16 token);
+
+}
+
+#endif
@@ -0,0 +1,424 @@
+/* Everything besides GX the game needs from libogc on the host: the
+ * video interface, controllers driven by a script, the time base, the
+ * gu matrix functions and silent audio. Configuration comes from the
+ * environment, see the README.
+ *
+ * By default the time base is virtual. It jumps to the next retrace at
+ * every VIDEO_WaitVSync and moves a little at every gettime(), so time
+ * budgets and the timings drawn on screen are the same on every run. */
+#include "shim.h"
+#include "include/asndlib.h"
+#include "include/fairy_path_ogg.h"
+#include "include/ogc/lwp_watchdog.h"
+#include "../source/library/oggplayer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+namespace host {
+
+Config config;
+
+#define HOST_PADS 4
+#define FRAME_TICKS (TB_TIMER_CLOCK * 1000 / 60)
+#define GETTIME_TICKS (TB_TIMER_CLOCK / 10) // 100 microseconds a call
+
+/* One line of the input script: from frame on, pad holds these buttons */
+struct InputEvent {
+    u32 frame;
+    int pad;
+    u16 held;
+    s8 stick_x;
+    s8 stick_y;
+};
+
+static std::vector<InputEvent> input_events;
+static u32 connected_pads = 1;
+
+static FILE* open_output(const char* variable) {
+    const char* path = getenv(variable);
+    if(path == NULL || path[0] == '\0') return NULL;
+    FILE* file = fopen(path, "w");
+    if(file == NULL) {
+        fprintf(stderr, "host: can't write %s given in %s\n", path, variable);
+        exit(1);
+    }
+    return file;
+}
+
+static bool flag(const char* variable) {
+    const char* value = getenv(variable);
+    return value != NULL && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+
+static void load_input(const char* path) {
+    FILE* file = fopen(path, "r");
+    if(file == NULL) {
+        fprintf(stderr, "host: can't read the input script %s\n", path);
+        exit(1);
+    }
+    char line[256];
+    int number = 0;
+    while(fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        char* start = line + strspn(line, " \t");
+        if(*start == '#' || *start == '\n' || *start == '\0') continue;
+        unsigned frame, held;
+        int pad, stick_x = 0, stick_y = 0;
+        int fields = sscanf(start, "%u %d %x %d %d", &frame, &pad, &held, &stick_x, &stick_y);
+        if(fields < 3 || pad < 0 || pad >= HOST_PADS) {
+            fprintf(stderr, "host: %s:%d should be \"frame pad buttons [stick_x stick_y]\"\n", path, number);
+            exit(1);
+        }
+        input_events.push_back(InputEvent { frame, pad, (u16)held, (s8)stick_x, (s8)stick_y });
+    }
+    fclose(file);
+}
+
+void load_config() {
+    static bool loaded = false;
+    if(loaded) return;
+    loaded = true;
+    const char* frames = getenv("HOST_FRAMES");
+    config.frames = frames != NULL ? strtoul(frames, NULL, 10) : 300;
+    config.snapshot_dir = getenv("HOST_SNAPSHOT_DIR");
+    if(config.snapshot_dir != NULL && config.snapshot_dir[0] == '\0') config.snapshot_dir = NULL;
+    const char* snapshot_frames = getenv("HOST_SNAPSHOT_FRAMES");
+    while(snapshot_frames != NULL && *snapshot_frames != '\0') {
+        char* end;
+        config.snapshot_frames.push_back(strtoul(snapshot_frames, &end, 10));
+        snapshot_frames = *end == ',' ? end + 1 : NULL;
+    }
+    config.rasterize = flag("HOST_RASTERIZE") || config.snapshot_dir != NULL;
+    config.trace = open_output("HOST_TRACE");
+    config.trace_vertices = flag("HOST_TRACE_VERTICES");
+    config.stats = open_output("HOST_STATS");
+    if(config.stats != NULL) {
+        fprintf(config.stats, "frame,fifo_bytes,list_bytes,draw_calls,vertices,state_changes,matrix_loads,"
+                "texture_loads,list_calls,efb_copies,quads,quad_draws,quads_per_draw\n");
+    }
+    const char* seed = getenv("HOST_SEED");
+    config.seed = seed != NULL ? strtoul(seed, NULL, 10) : 1;
+    config.real_time = flag("HOST_REAL_TIME");
+    const char* pads = getenv("HOST_PADS");
+    int pad_count = pads != NULL ? atoi(pads) : 1;
+    if(pad_count < 0) pad_count = 0;
+    if(pad_count > HOST_PADS) pad_count = HOST_PADS;
+    connected_pads = (1 << pad_count) - 1;
+    const char* input = getenv("HOST_INPUT");
+    if(input != NULL && input[0] != '\0') load_input(input);
+}
+
+/* Static initialization runs before main(), so the configuration is
+ * there before srand(time(NULL)) and the first GX call */
+static struct ConfigLoader {
+    ConfigLoader() {
+        load_config();
+    }
+} config_loader;
+
+/* Time base */
+static u64 virtual_ticks = 0;
+static u32 retraces = 0;
+
+static u64 clock_ticks() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    u64 nanoseconds = (u64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    return nanoseconds * 243 / 4000;
+}
+
+/* Controllers, as the script has them at the last PAD_ScanPads */
+static u16 pad_held[HOST_PADS];
+static u16 pad_previous[HOST_PADS];
+static s8 pad_stick_x[HOST_PADS];
+static s8 pad_stick_y[HOST_PADS];
+
+static VIRetraceCallback post_retrace = NULL;
+static VIRetraceCallback pre_retrace = NULL;
+
+}
+
+using namespace host;
+
+/* Linked with --wrap=time, the world is seeded from this */
+extern "C" time_t __wrap_time(time_t* result) {
+    if(result != NULL) *result = config.seed;
+    return config.seed;
+}
+
+extern "C" {
+
+u64 gettime(void) {
+    if(config.real_time) return clock_ticks();
+    virtual_ticks += GETTIME_TICKS;
+    return virtual_ticks;
+}
+
+u64 ticks_to_microsecs(u64 ticks) {
+    return ticks * 8 / (TB_TIMER_CLOCK / 125);
+}
+
+u64 microsecs_to_ticks(u64 microsecs) {
+    return microsecs * (TB_TIMER_CLOCK / 125) / 8;
+}
+
+u32 diff_usec(u64 start, u64 end) {
+    return ticks_to_microsecs(end - start);
+}
+
+u32 diff_msec(u64 start, u64 end) {
+    return (end - start) / TB_TIMER_CLOCK;
+}
+
+/* Video */
+void VIDEO_Init(void) {
+    load_config();
+}
+
+GXRModeObj* VIDEO_GetPreferredMode(GXRModeObj* mode) {
+    static GXRModeObj preferred;
+    preferred.viTVMode = VI_NON_INTERLACE;
+    preferred.fbWidth = 640;
+    preferred.efbHeight = 480;
+    preferred.xfbHeight = 480;
+    preferred.viXOrigin = 40;
+    preferred.viYOrigin = 0;
+    preferred.viWidth = 640;
+    preferred.viHeight = 480;
+    preferred.xfbMode = 0;
+    preferred.field_rendering = 0;
+    preferred.aa = 0;
+    for(int i = 0; i < 12; i++) {
+        preferred.sample_pattern[i][0] = 6;
+        preferred.sample_pattern[i][1] = 6;
+    }
+    static const u8 filter[7] = { 0, 0, 21, 22, 21, 0, 0 };
+    memcpy(preferred.vfilter, filter, sizeof(filter));
+    if(mode != NULL) {
+        *mode = preferred;
+        return mode;
+    }
+    return &preferred;
+}
+
+void VIDEO_Configure(GXRModeObj* mode) {}
+void VIDEO_SetNextFramebuffer(void* buffer) {}
+void VIDEO_SetBlack(BOOL black) {}
+void VIDEO_Flush(void) {}
+
+/// Where the GPU catches up with the CPU, and where the run ends once
+/// enough frames were copied out
+void VIDEO_WaitVSync(void) {
+    execute_fifo();
+    if(frames_copied() > config.frames) {
+        finish();
+        exit(0);
+    }
+    // console mode never copies a frame, it's stopped after as many retraces
+    if(retraces > config.frames * 4 + 600) {
+        fprintf(stderr, "host: %u retraces without %u frames, giving up\n", retraces, config.frames);
+        finish();
+        exit(1);
+    }
+    retraces++;
+    if(!config.real_time) {
+        u64 next = (u64)retraces * FRAME_TICKS;
+        if(virtual_ticks < next) virtual_ticks = next;
+    }
+    if(pre_retrace != NULL) pre_retrace(retraces);
+    if(post_retrace != NULL) post_retrace(retraces);
+    // callbacks may have sent commands
+    execute_fifo();
+}
+
+u32 VIDEO_GetRetraceCount(void) {
+    return retraces;
+}
+
+VIRetraceCallback VIDEO_SetPreRetraceCallback(VIRetraceCallback callback) {
+    VIRetraceCallback previous = pre_retrace;
+    pre_retrace = callback;
+    return previous;
+}
+
+VIRetraceCallback VIDEO_SetPostRetraceCallback(VIRetraceCallback callback) {
+    VIRetraceCallback previous = post_retrace;
+    post_retrace = callback;
+    return previous;
+}
+
+void* SYS_AllocateFramebuffer(GXRModeObj* mode) {
+    return calloc(mode->fbWidth * mode->xfbHeight, VI_DISPLAY_PIX_SZ);
+}
+
+void console_init(void* framebuffer, int x, int y, int width, int height, int stride) {}
+
+/* Controllers */
+u32 PAD_Init(void) {
+    load_config();
+    return 1;
+}
+
+/// Applies every line of the script up to the frame being built
+u32 PAD_ScanPads(void) {
+    u32 frame = frames_copied();
+    for(int pad = 0; pad < HOST_PADS; pad++) {
+        pad_previous[pad] = pad_held[pad];
+    }
+    for(const InputEvent &event : input_events) {
+        if(event.frame > frame) continue;
+        pad_held[event.pad] = event.held;
+        pad_stick_x[event.pad] = event.stick_x;
+        pad_stick_y[event.pad] = event.stick_y;
+    }
+    return connected_pads;
+}
+
+u16 PAD_ButtonsDown(int pad) {
+    if(pad < 0 || pad >= HOST_PADS) return 0;
+    return pad_held[pad] & ~pad_previous[pad];
+}
+
+u16 PAD_ButtonsUp(int pad) {
+    if(pad < 0 || pad >= HOST_PADS) return 0;
+    return pad_previous[pad] & ~pad_held[pad];
+}
+
+u16 PAD_ButtonsHeld(int pad) {
+    if(pad < 0 || pad >= HOST_PADS) return 0;
+    return pad_held[pad];
+}
+
+s8 PAD_StickX(int pad) {
+    if(pad < 0 || pad >= HOST_PADS) return 0;
+    return pad_stick_x[pad];
+}
+
+s8 PAD_StickY(int pad) {
+    if(pad < 0 || pad >= HOST_PADS) return 0;
+    return pad_stick_y[pad];
+}
+
+/* The cache is coherent on the host */
+void DCFlushRange(void* start, u32 size) {}
+void DCInvalidateRange(void* start, u32 size) {}
+void DCStoreRange(void* start, u32 size) {}
+
+/* Matrices, the same math as libogc's C versions */
+void guOrtho(Mtx44 matrix, f32 top, f32 bottom, f32 left, f32 right, f32 near, f32 far) {
+    memset(matrix, 0, sizeof(Mtx44));
+    f32 scale = 1.0F / (right - left);
+    matrix[0][0] = 2.0F * scale;
+    matrix[0][3] = -(right + left) * scale;
+    scale = 1.0F / (top - bottom);
+    matrix[1][1] = 2.0F * scale;
+    matrix[1][3] = -(top + bottom) * scale;
+    scale = 1.0F / (far - near);
+    matrix[2][2] = -1.0F * scale;
+    matrix[2][3] = -far * scale;
+    matrix[3][3] = 1.0F;
+}
+
+void guMtxIdentity(Mtx matrix) {
+    memset(matrix, 0, sizeof(Mtx));
+    matrix[0][0] = 1.0F;
+    matrix[1][1] = 1.0F;
+    matrix[2][2] = 1.0F;
+}
+
+void guMtxCopy(Mtx src, Mtx dst) {
+    if(src != dst) memcpy(dst, src, sizeof(Mtx));
+}
+
+void guMtxConcat(Mtx a, Mtx b, Mtx ab) {
+    Mtx result;
+    for(int row = 0; row < 3; row++) {
+        for(int column = 0; column < 4; column++) {
+            result[row][column] = a[row][0] * b[0][column] + a[row][1] * b[1][column] + a[row][2] * b[2][column];
+        }
+        result[row][3] += a[row][3];
+    }
+    memcpy(ab, result, sizeof(Mtx));
+}
+
+void guMtxTrans(Mtx matrix, f32 x, f32 y, f32 z) {
+    guMtxIdentity(matrix);
+    matrix[0][3] = x;
+    matrix[1][3] = y;
+    matrix[2][3] = z;
+}
+
+void guMtxTransApply(Mtx src, Mtx dst, f32 x, f32 y, f32 z) {
+    guMtxCopy(src, dst);
+    dst[0][3] += x;
+    dst[1][3] += y;
+    dst[2][3] += z;
+}
+
+void guMtxScale(Mtx matrix, f32 x, f32 y, f32 z) {
+    memset(matrix, 0, sizeof(Mtx));
+    matrix[0][0] = x;
+    matrix[1][1] = y;
+    matrix[2][2] = z;
+}
+
+void guMtxScaleApply(Mtx src, Mtx dst, f32 x, f32 y, f32 z) {
+    f32 scale[3] = { x, y, z };
+    for(int row = 0; row < 3; row++) {
+        for(int column = 0; column < 4; column++) {
+            dst[row][column] = src[row][column] * scale[row];
+        }
+    }
+}
+
+void guMtxRotRad(Mtx matrix, char axis, f32 radians) {
+    f32 sine = sinf(radians);
+    f32 cosine = cosf(radians);
+    guMtxIdentity(matrix);
+    switch(axis) {
+        case 'x': case 'X':
+            matrix[1][1] = cosine;
+            matrix[1][2] = -sine;
+            matrix[2][1] = sine;
+            matrix[2][2] = cosine;
+            break;
+        case 'y': case 'Y':
+            matrix[0][0] = cosine;
+            matrix[0][2] = sine;
+            matrix[2][0] = -sine;
+            matrix[2][2] = cosine;
+            break;
+        default:
+            matrix[0][0] = cosine;
+            matrix[0][1] = -sine;
+            matrix[1][0] = sine;
+            matrix[1][1] = cosine;
+            break;
+    }
+}
+
+/* Audio is silent */
+void ASND_Init(void) {}
+void ASND_End(void) {}
+
+}
+
+int PlayOgg(const void* buffer, s32 len, int time_pos, int mode) {
+    return 0;
+}
+
+void StopOgg() {}
+void PauseOgg(int pause) {}
+int StatusOgg() {
+    return OGG_STATUS_EOF;
+}
+void SetVolumeOgg(int volume) {}
+s32 GetTimeOgg() {
+    return 0;
+}
+void SetTimeOgg(s32 time_pos) {}
+
+const u8 fairy_path_ogg[1] = { 0 };
+const u32 fairy_path_ogg_size = 0;
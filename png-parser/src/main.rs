@@ -1,10 +1,386 @@
+use std::collections::HashMap;
+use std::fmt::Write;
 use std::fs;
+use std::path::Path;
+
+const PALETTE_SIZE: usize = 256;
+/// Transparent pixels kept around every packed sprite, filled with its
+/// edge so sampling right at the border never picks up a neighbour
+const PADDING: usize = 1;
+/// GX textures are stored in blocks, 8x4 is enough for every format used
+const BLOCK_WIDTH: usize = 8;
+const BLOCK_HEIGHT: usize = 4;
+const MAX_TEXTURE_SIZE: usize = 1024;
+
+/// Textures the atlas is split into, in the order the game expects them.
+/// Every sprite goes to the smallest format that still fits it.
+#[derive(Clone, Copy, PartialEq)]
+enum Region {
+    Glyphs,  // gray with alpha, IA4
+    Sprites, // color with alpha, RGB5A3
+    Tiles,   // opaque color, RGB565
+}
+
+const REGIONS: [Region; 3] = [Region::Glyphs, Region::Sprites, Region::Tiles];
+
+type Pixel = [u8; 4];
+
+struct Image {
+    width: usize,
+    height: usize,
+    pixels: Vec<Pixel>,
+}
+
+impl Image {
+    fn blank(width: usize, height: usize) -> Image {
+        Image { width, height, pixels: vec![[0, 0, 0, 0]; width * height] }
+    }
+
+    fn load(path: &Path) -> Image {
+        let mut decoder = png::Decoder::new(fs::File::open(path).unwrap());
+        decoder.set_transformations(png::Transformations::EXPAND);
+        let (info, mut reader) = decoder.read_info().unwrap();
+        let mut data = vec![0; info.buffer_size()];
+        reader.next_frame(&mut data).unwrap();
+        let pixels: Vec<Pixel> = match info.color_type {
+            png::ColorType::RGBA => data.chunks(4).map(|p| [p[0], p[1], p[2], p[3]]).collect(),
+            png::ColorType::RGB => data.chunks(3).map(|p| [p[0], p[1], p[2], 0xff]).collect(),
+            other => {
+                println!("can't pack {:?} images: {}", other, path.display());
+                std::process::exit(1);
+            }
+        };
+        Image { width: info.width as usize, height: info.height as usize, pixels }
+    }
+
+    fn pixel(&self, x: usize, y: usize) -> Pixel {
+        self.pixels[y * self.width + x]
+    }
+}
+
+/// One line of the manifest, trimmed down to its visible pixels
+struct Sprite {
+    name: String,
+    image: Image,
+    trim_x: usize,
+    trim_y: usize,
+    source_width: usize,
+    source_height: usize,
+    region: Region,
+    // where it was packed in the texture of its region
+    x: usize,
+    y: usize,
+}
+
+impl Sprite {
+    /// Cuts the sprite out of source and drops transparent rows and
+    /// columns around it
+    fn cut(name: &str, source: &Image, x: usize, y: usize, width: usize, height: usize) -> Sprite {
+        if x + width > source.width || y + height > source.height {
+            println!("{} is outside of its image", name);
+            std::process::exit(1);
+        }
+        let (mut left, mut top, mut right, mut bottom) = (width, height, 0, 0);
+        for sy in 0..height {
+            for sx in 0..width {
+                if source.pixel(x + sx, y + sy)[3] != 0 {
+                    left = left.min(sx);
+                    top = top.min(sy);
+                    right = right.max(sx + 1);
+                    bottom = bottom.max(sy + 1);
+                }
+            }
+        }
+        if right == 0 {
+            println!("{} is empty", name);
+            std::process::exit(1);
+        }
+        let mut image = Image::blank(right - left, bottom - top);
+        for sy in 0..image.height {
+            for sx in 0..image.width {
+                image.pixels[sy * image.width + sx] = source.pixel(x + left + sx, y + top + sy);
+            }
+        }
+        let region = classify(&image);
+        Sprite {
+            name: name.to_string(),
+            image,
+            trim_x: left,
+            trim_y: top,
+            source_width: width,
+            source_height: height,
+            region,
+            x: 0,
+            y: 0,
+        }
+    }
+}
+
+fn classify(image: &Image) -> Region {
+    let mut opaque = true;
+    let mut gray = true;
+    for &[r, g, b, a] in &image.pixels {
+        if a != 0 && r.max(g).max(b) - r.min(g).min(b) >= 16 {
+            gray = false;
+        }
+        if a != 0xff {
+            opaque = false;
+        }
+    }
+    if opaque {
+        Region::Tiles
+    } else if gray {
+        Region::Glyphs
+    } else {
+        Region::Sprites
+    }
+}
+
+/// Reads the manifest, every line is a name, an image relative to the
+/// manifest and optionally the x, y, width and height of the sprite in it
+fn read_manifest(path: &Path) -> Vec<Sprite> {
+    let directory = path.parent().unwrap_or(Path::new("."));
+    let text = fs::read_to_string(path).unwrap();
+    let mut images: HashMap<String, Image> = HashMap::new();
+    let mut sprites = Vec::new();
+    for line in text.lines() {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let fields: Vec<&str> = line.split_whitespace().collect();
+        if fields.len() != 2 && fields.len() != 6 {
+            println!("expected <name> <image> [<x> <y> <width> <height>]: {}", line);
+            std::process::exit(1);
+        }
+        let image = images
+            .entry(fields[1].to_string())
+            .or_insert_with(|| Image::load(&directory.join(fields[1])));
+        let rect: Vec<usize> = fields[2..].iter().map(|f| f.parse().unwrap()).collect();
+        let (x, y, width, height) = match rect.as_slice() {
+            &[x, y, width, height] => (x, y, width, height),
+            _ => (0, 0, image.width, image.height),
+        };
+        sprites.push(Sprite::cut(fields[0], image, x, y, width, height));
+    }
+    sprites
+}
+
+/// Packs sprites into rows of a texture width pixels wide, tallest
+/// first. Returns the height it took, or None if a sprite doesn't fit.
+fn pack_rows(sprites: &mut [&mut Sprite], width: usize) -> Option<usize> {
+    let (mut x, mut y, mut row_height) = (0, 0, 0);
+    for sprite in sprites.iter_mut() {
+        let w = sprite.image.width + 2 * PADDING;
+        let h = sprite.image.height + 2 * PADDING;
+        if w > width {
+            return None;
+        }
+        if x + w > width {
+            x = 0;
+            y += row_height;
+            row_height = 0;
+        }
+        sprite.x = x + PADDING;
+        sprite.y = y + PADDING;
+        x += w;
+        row_height = row_height.max(h);
+    }
+    let height = y + row_height;
+    Some((height + BLOCK_HEIGHT - 1) / BLOCK_HEIGHT * BLOCK_HEIGHT)
+}
+
+/// Packs sprites into the smallest texture it can find and draws them in
+fn pack(mut sprites: Vec<&mut Sprite>) -> Image {
+    sprites.sort_by(|a, b| b.image.height.cmp(&a.image.height).then(b.image.width.cmp(&a.image.width)));
+    let mut best: Option<(usize, usize)> = None;
+    for width in (BLOCK_WIDTH..=MAX_TEXTURE_SIZE).step_by(BLOCK_WIDTH) {
+        if let Some(height) = pack_rows(&mut sprites, width) {
+            let height = height.max(BLOCK_HEIGHT);
+            let smaller = match best {
+                Some((w, h)) => width * height < w * h,
+                None => true,
+            };
+            if height <= MAX_TEXTURE_SIZE && smaller {
+                best = Some((width, height));
+            }
+        }
+    }
+    let (width, height) = best.unwrap_or_else(|| {
+        println!("sprites don't fit in a {0}x{0} texture", MAX_TEXTURE_SIZE);
+        std::process::exit(1);
+    });
+    pack_rows(&mut sprites, width);
+
+    let mut texture = Image::blank(width, height);
+    for sprite in sprites {
+        let image = &sprite.image;
+        // copy with the edge stretched out into the padding
+        for y in 0..image.height + 2 * PADDING {
+            for x in 0..image.width + 2 * PADDING {
+                let sx = x.max(PADDING).min(image.width + PADDING - 1) - PADDING;
+                let sy = y.max(PADDING).min(image.height + PADDING - 1) - PADDING;
+                let tx = sprite.x + x - PADDING;
+                let ty = sprite.y + y - PADDING;
+                texture.pixels[ty * width + tx] = image.pixel(sx, sy);
+            }
+        }
+    }
+    texture
+}
+
+/// Converts a texture into GX texels, which are stored in blocks of
+/// block_width by block_height
+fn texels<T, F>(image: &Image, block_width: usize, block_height: usize, convert: F) -> Vec<T>
+where
+    F: Fn(Pixel) -> T,
+{
+    let mut texels = Vec::with_capacity(image.width * image.height);
+    for block_y in (0..image.height).step_by(block_height) {
+        for block_x in (0..image.width).step_by(block_width) {
+            for y in block_y..block_y + block_height {
+                for x in block_x..block_x + block_width {
+                    texels.push(convert(image.pixel(x, y)));
+                }
+            }
+        }
+    }
+    texels
+}
+
+fn ia4([r, g, b, a]: Pixel) -> u8 {
+    let intensity = (r as u16 * 77 + g as u16 * 150 + b as u16 * 29) >> 8;
+    (a >> 4) << 4 | (intensity as u8) >> 4
+}
+
+fn rgb565([r, g, b, _]: Pixel) -> u16 {
+    let (r, g, b) = (r as u16, g as u16, b as u16);
+    (r >> 3) << 11 | (g >> 2) << 5 | b >> 3
+}
+
+/// Every fully transparent pixel becomes the same color, so they all
+/// share one palette entry
+fn rgb5a3([r, g, b, a]: Pixel) -> u16 {
+    let (r, g, b, a) = (r as u16, g as u16, b as u16, a as u16);
+    if a >= 0xe0 {
+        0x8000 | (r >> 3) << 10 | (g >> 3) << 5 | b >> 3
+    } else if a >> 5 == 0 {
+        0
+    } else {
+        (a >> 5) << 12 | (r >> 4) << 8 | (g >> 4) << 4 | b >> 4
+    }
+}
+
+/// Writes values as the body of a C array, 16 to a line
+fn write_array<T: std::fmt::Display>(out: &mut String, values: &[T]) {
+    for line in values.chunks(16) {
+        out.push_str("   ");
+        for value in line {
+            write!(out, " {},", value).unwrap();
+        }
+        out.push('\n');
+    }
+}
+
+fn write_texels<T: std::fmt::Display>(out: &mut String, kind: &str, name: &str, values: &[T]) {
+    writeln!(out, "static const {} {}[{}] __attribute__((aligned(32))) = {{", kind, name, values.len()).unwrap();
+    write_array(out, values);
+    out.push_str("};\n");
+}
+
+/// Produces a header with an enum of every sprite in the manifest, where
+/// each one was packed, and the texture of every region. The sprite
+/// region comes once more as CI8 with its palette.
+fn table_header(mut sprites: Vec<Sprite>) -> String {
+    let mut textures = Vec::new();
+    for &region in REGIONS.iter() {
+        let members: Vec<&mut Sprite> = sprites.iter_mut().filter(|s| s.region == region).collect();
+        textures.push(pack(members));
+    }
+
+    // transparent first, so index 0 is always see-through
+    let sprite_colors = texels(&textures[1], 8, 4, rgb5a3);
+    let mut palette: Vec<u16> = vec![0];
+    let mut indices = Vec::with_capacity(sprite_colors.len());
+    for color in sprite_colors {
+        let entry = match palette.iter().position(|&c| c == color) {
+            Some(entry) => entry,
+            None => {
+                palette.push(color);
+                palette.len() - 1
+            }
+        };
+        if entry >= PALETTE_SIZE {
+            println!("sprites have more than {} colors, can't make a CI8 texture", PALETTE_SIZE);
+            std::process::exit(1);
+        }
+        indices.push(entry as u8);
+    }
+    let colors = palette.len();
+    palette.resize(PALETTE_SIZE, 0);
+
+    let mut out = String::new();
+    out.push_str("/* Generated by png_parser from the atlas manifest, don't edit */\n");
+    out.push_str("enum SpriteId {\n");
+    for sprite in &sprites {
+        writeln!(out, "    SPRITE_{},", sprite.name).unwrap();
+    }
+    out.push_str("    SPRITE_COUNT\n};\n");
+
+    out.push_str("/* Where a sprite was packed in the texture of its region, and where\n");
+    out.push_str(" * that trimmed part sits in the sprite as it was drawn */\n");
+    out.push_str("struct SpriteRect {\n");
+    out.push_str("    u8 region;\n");
+    out.push_str("    u16 x, y, width, height;\n");
+    out.push_str("    u16 trim_x, trim_y, source_width, source_height;\n");
+    out.push_str("};\n");
+    out.push_str("static constexpr SpriteRect sprite_rects[SPRITE_COUNT] = {\n");
+    for sprite in &sprites {
+        let region = REGIONS.iter().position(|&r| r == sprite.region).unwrap();
+        writeln!(
+            out,
+            "    {{{}, {}, {}, {}, {}, {}, {}, {}, {}}}, // {}",
+            region,
+            sprite.x,
+            sprite.y,
+            sprite.image.width,
+            sprite.image.height,
+            sprite.trim_x,
+            sprite.trim_y,
+            sprite.source_width,
+            sprite.source_height,
+            sprite.name
+        )
+        .unwrap();
+    }
+    out.push_str("};\n");
+
+    writeln!(out, "#define REGION_COUNT {}", REGIONS.len()).unwrap();
+    let widths: Vec<usize> = textures.iter().map(|t| t.width).collect();
+    let heights: Vec<usize> = textures.iter().map(|t| t.height).collect();
+    out.push_str("static constexpr u16 region_widths[REGION_COUNT] = {\n");
+    write_array(&mut out, &widths);
+    out.push_str("};\n");
+    out.push_str("static constexpr u16 region_heights[REGION_COUNT] = {\n");
+    write_array(&mut out, &heights);
+    out.push_str("};\n");
+
+    write_texels(&mut out, "u8", "glyphs_ia4", &texels(&textures[0], 8, 4, ia4));
+    write_texels(&mut out, "u16", "sprites_rgb5a3", &texels(&textures[1], 4, 4, rgb5a3));
+    write_texels(&mut out, "u16", "tiles_rgb565", &texels(&textures[2], 4, 4, rgb565));
+    writeln!(out, "#define PALETTE_COLORS {}", colors).unwrap();
+    write_texels(&mut out, "u16", "sprites_palette", &palette);
+    write_texels(&mut out, "u8", "sprites_ci8", &indices);
+    out
+}
 
 fn main() {
     // args
     let mut args = std::env::args().skip(1);
     let image_path = args.next();
     let header_path = args.next();
+    let manifest_path = args.next();
+    let table_path = args.next();
 
     if let (Some(image_path), Some(header_path)) = (image_path, header_path) {
         // image data
@@ -18,10 +394,19 @@ fn main() {
         fs::write(header_path, header_data).unwrap_or_else(|e| {
             dbg!(e);
         });
+
+        if let (Some(manifest_path), Some(table_path)) = (manifest_path, table_path) {
+            let sprites = read_manifest(Path::new(&manifest_path));
+            fs::write(table_path, table_header(sprites)).unwrap_or_else(|e| {
+                dbg!(e);
+            });
+        }
     } else {
         println!("USAGE:");
-        println!("    png_parser <image_path> <header_path>");
+        println!("    png_parser <image_path> <header_path> [<manifest_path> <table_header_path>]");
         println!("INFO:");
-        println!("    produces header file info based on image width and height");
+        println!("    produces header file info based on image width and height,");
+        println!("    and optionally packs the sprites listed in the manifest into");
+        println!("    textures, with a header of where every sprite ended up");
     }
 }
@@ -0,0 +1,57 @@
+#define TEXMTX_STILL GX_IDENTITY
+#define TEXMTX_WATER GX_TEXMTX0
+#define WATER_INSET 0.125   // of the tile on every side the ripple moves into
+#define WATER_SPEED 0.05    // radians a frame
+
+/// The texture matrix a terrain tile picks for its texture coordinates
+constexpr u8 tile_texture_matrix(SpriteId id) {
+    return id == SPRITE_WATER ? TEXMTX_WATER : TEXMTX_STILL;
+}
+
+/* Animates terrain tiles without touching them. Every vertex of a tile
+ * picks a texture matrix, which is recorded into chunk display lists
+ * once, and only the matrix is loaded again every frame. So the cost is
+ * the same however much water is on screen, and chunks never have to be
+ * recorded again. */
+class TileAnimation {
+public:
+    u32 frame;
+    TileAnimation() {
+        this->frame = 0;
+    }
+    /// Loads the matrices for the first frame, has to run after GX_Init
+    void setup() {
+        Mtx identity;
+        guMtxIdentity(identity);
+        // still tiles point at it per vertex too, so don't rely on it being loaded
+        GX_LoadTexMtxImm(identity, TEXMTX_STILL, GX_MTX2x4);
+        this->load();
+    }
+    /// Moves every animated tile on by a frame
+    void advance() {
+        this->frame++;
+        this->load();
+    }
+private:
+    /// Water is sampled from a smaller square of its tile that drifts in a
+    /// circle, never further than the inset so it can't reach the
+    /// neighbouring tiles in the texture.
+    void load() {
+        const UV &uv = sprite_uv(SPRITE_WATER);
+        f32 width = uv.s1 - uv.s0;
+        f32 height = uv.t1 - uv.t0;
+        f32 center_s = uv.s0 + width / 2;
+        f32 center_t = uv.t0 + height / 2;
+        f32 scale = 1.0F - 2 * WATER_INSET;
+        f32 angle = this->frame * WATER_SPEED;
+        Mtx water;
+        guMtxIdentity(water);
+        water[0][0] = scale;
+        water[0][3] = center_s * (1.0F - scale) + WATER_INSET * width * sinf(angle);
+        water[1][1] = scale;
+        water[1][3] = center_t * (1.0F - scale) + WATER_INSET * height * cosf(angle);
+        GX_LoadTexMtxImm(water, TEXMTX_WATER, GX_MTX2x4);
+    }
+};
+
+TileAnimation tile_animation;
@@ -0,0 +1,116 @@
+#define WIDTH 64
+#define HEIGHT 64
+
+/* Texture coordinates of one sprite, both as floats and as
+ * fixed point with TEXCOORD_FRAC fraction bits for compact vertices */
+struct UV {
+    f32 s0, t0, s1, t1;
+    u16 fs0, ft0, fs1, ft1;
+};
+
+constexpr u16 to_fixed_texcoord(double value) {
+    return (u16)(value * (1 << TEXCOORD_FRAC) + 0.5);
+}
+
+constexpr UV make_uv(double s0, double t0, double s1, double t1) {
+    return UV {
+        (f32)s0, (f32)t0, (f32)s1, (f32)t1,
+        to_fixed_texcoord(s0), to_fixed_texcoord(t0), to_fixed_texcoord(s1), to_fixed_texcoord(t1)
+    };
+}
+
+/* Textures the atlas is split into by png_parser, each sprite goes to
+ * the smallest format that still holds it. The order matches the region
+ * numbers in sprite_table.h. */
+enum TextureRegion {
+    REGION_GLYPHS,  // gray with alpha, IA4
+    REGION_SPRITES, // color with alpha, RGB5A3
+    REGION_TILES    // opaque, RGB565
+};
+
+static_assert(REGION_COUNT == 3, "sprite_table.h is out of date");
+
+struct UVTable {
+    UV sprites[SPRITE_COUNT];
+};
+
+/// Builds texture coordinates for every sprite in the texture of its
+/// region, so drawing never has to divide at runtime
+constexpr UVTable make_uv_table() {
+    UVTable table = {};
+    for(int id = 0; id < SPRITE_COUNT; id++) {
+        const SpriteRect &rect = sprite_rects[id];
+        double width = region_widths[rect.region];
+        double height = region_heights[rect.region];
+        table.sprites[id] = make_uv(rect.x / width, rect.y / height,
+                (rect.x + rect.width) / width, (rect.y + rect.height) / height);
+    }
+    return table;
+}
+
+constexpr UVTable uv_table = make_uv_table();
+
+/// Returns texture coordinates for a sprite, e.g. sprite_uv(SPRITE_GRASS)
+constexpr const UV& sprite_uv(SpriteId id) {
+    return uv_table.sprites[id];
+}
+
+constexpr int sprite_region(SpriteId id) {
+    return sprite_rects[id].region;
+}
+
+/// Whether png_parser didn't have to trim anything off the sprite
+constexpr bool untrimmed(SpriteId id) {
+    return sprite_rects[id].width == sprite_rects[id].source_width
+        && sprite_rects[id].height == sprite_rects[id].source_height;
+}
+
+/* The part of a sprite that has pixels in it */
+struct SpriteBox {
+    int x, y, width, height;
+};
+
+/// Where the trimmed sprite goes when the whole sprite is drawn at x and
+/// y, width by height, so sprites line up as they did before trimming
+inline SpriteBox trimmed_box(SpriteId id, int x, int y, int width, int height) {
+    const SpriteRect &rect = sprite_rects[id];
+    SpriteBox box;
+    box.x = x + rect.trim_x * width / rect.source_width;
+    box.y = y + rect.trim_y * height / rect.source_height;
+    box.width = rect.width * width / rect.source_width;
+    box.height = rect.height * height / rect.source_height;
+    if(box.width < 1) box.width = 1;
+    if(box.height < 1) box.height = 1;
+    return box;
+}
+
+GXTexObj region_textures[REGION_COUNT];
+
+/// Sets up a texture object for every region, has to run after GX_Init
+void setup_region_textures() {
+    void* texels[REGION_COUNT] = { (void*)glyphs_ia4, (void*)sprites_rgb5a3, (void*)tiles_rgb565 };
+    u8 formats[REGION_COUNT] = { GX_TF_IA4, GX_TF_RGB5A3, GX_TF_RGB565 };
+    for(int region = 0; region < REGION_COUNT; region++) {
+        GXTexObj &texture = region_textures[region];
+        GX_InitTexObj(&texture, texels[region], region_widths[region], region_heights[region],
+                formats[region], GX_CLAMP, GX_CLAMP, GX_FALSE);
+        GX_InitTexObjFilterMode(&texture, GX_NEAR, GX_NEAR);
+    }
+}
+
+/// Texture a sprite is drawn from
+GXTexObj* atlas_texture(SpriteId id) {
+    return &region_textures[sprite_region(id)];
+}
+
+/// Terrain is drawn from shared corner arrays and baked into chunks
+/// tile by tile, so its sprites have to fill the whole tile
+constexpr bool terrain_sprite(SpriteId id) {
+    return sprite_region(id) == REGION_TILES && untrimmed(id)
+        && sprite_rects[id].source_width == WIDTH && sprite_rects[id].source_height == HEIGHT;
+}
+
+static_assert(terrain_sprite(SPRITE_GRASS), "terrain has to be opaque 64x64 tiles");
+static_assert(terrain_sprite(SPRITE_WATER), "terrain has to be opaque 64x64 tiles");
+static_assert(terrain_sprite(SPRITE_STONE), "terrain has to be opaque 64x64 tiles");
+static_assert(terrain_sprite(SPRITE_DIRT), "terrain has to be opaque 64x64 tiles");
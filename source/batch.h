@@ -0,0 +1,275 @@
+#define BATCH_CAPACITY 2048
+/* Position matrices a batch can hand out, GX_PNMTX1 to GX_PNMTX9 */
+#define BATCH_TRANSFORMS 9
+
+/* All blend states a batch can be flushed with */
+enum BlendState {
+    BLEND_NONE,   // opaque, depth tested before texturing
+    BLEND_CUTOUT, // transparent texels are discarded by the alpha compare
+    BLEND_ALPHA   // blended with what is already drawn
+};
+
+/* Texels with less alpha than this are discarded in BLEND_CUTOUT */
+#define CUTOUT_ALPHA 128
+
+/* Counters for how well quads are being batched, reset every frame */
+struct BatchStats {
+    int quads;
+    int flushes;
+    int largest_flush;
+    int bytes;
+    void reset() {
+        this->quads = 0;
+        this->flushes = 0;
+        this->largest_flush = 0;
+        this->bytes = 0;
+    }
+    double quads_per_flush() {
+        if(this->flushes == 0) return 0.0;
+        return (double)this->quads / this->flushes;
+    }
+};
+
+/* One queued quad in world coordinates, depth away from the camera.
+ * Quads with a matrix other than GX_PNMTX0 are around their own center
+ * instead, the matrix moves them into the world. Animated tiles have a
+ * texture_matrix other than TEXMTX_STILL. */
+struct BatchQuad {
+    int x0, y0, x1, y1;
+    int depth;
+    u8 matrix;
+    u8 texture_matrix;
+    UV uv;
+};
+
+/// Sends quads in the current vertex mode, with positions relative to
+/// origin_x and origin_y. Every vertex picks its position matrix if the
+/// vertex descriptor has GX_VA_PTNMTXIDX, and its texture matrix if it
+/// has GX_VA_TEX0MTXIDX.
+void emit_quads(const BatchQuad* quads, int count, int origin_x, int origin_y) {
+    bool matrices = render_state.vtx_desc[GX_VA_PTNMTXIDX] == GX_DIRECT;
+    bool texture_matrices = render_state.vtx_desc[GX_VA_TEX0MTXIDX] == GX_DIRECT;
+    if(vertex_mode == VERTEX_COMPACT) {
+        GX_Begin(GX_QUADS, VTXFMT_COMPACT, count * 4);
+        for(int i = 0; i < count; i++) {
+            const BatchQuad &quad = quads[i];
+            int offset_x = quad.matrix == GX_PNMTX0 ? origin_x : 0;
+            int offset_y = quad.matrix == GX_PNMTX0 ? origin_y : 0;
+            s16 x0 = to_s16(quad.x0 - offset_x);
+            s16 y0 = to_s16(quad.y0 - offset_y);
+            s16 x1 = to_s16(quad.x1 - offset_x);
+            s16 y1 = to_s16(quad.y1 - offset_y);
+            s16 z = -quad.depth;
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3s16(x0, y0, z);
+            GX_TexCoord2u16(quad.uv.fs0, quad.uv.ft0);
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3s16(x1, y0, z);
+            GX_TexCoord2u16(quad.uv.fs1, quad.uv.ft0);
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3s16(x1, y1, z);
+            GX_TexCoord2u16(quad.uv.fs1, quad.uv.ft1);
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3s16(x0, y1, z);
+            GX_TexCoord2u16(quad.uv.fs0, quad.uv.ft1);
+        }
+        GX_End();
+    } else {
+        GX_Begin(GX_QUADS, VTXFMT_FLOAT, count * 4);
+        for(int i = 0; i < count; i++) {
+            const BatchQuad &quad = quads[i];
+            int offset_x = quad.matrix == GX_PNMTX0 ? origin_x : 0;
+            int offset_y = quad.matrix == GX_PNMTX0 ? origin_y : 0;
+            f32 x0 = quad.x0 - offset_x;
+            f32 y0 = quad.y0 - offset_y;
+            f32 x1 = quad.x1 - offset_x;
+            f32 y1 = quad.y1 - offset_y;
+            f32 z = -quad.depth;
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3f32(x0, y0, z);
+            GX_TexCoord2f32(quad.uv.s0, quad.uv.t0);
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3f32(x1, y0, z);
+            GX_TexCoord2f32(quad.uv.s1, quad.uv.t0);
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3f32(x1, y1, z);
+            GX_TexCoord2f32(quad.uv.s1, quad.uv.t1);
+            if(matrices) GX_MatrixIndex1x8(quad.matrix);
+            if(texture_matrices) GX_MatrixIndex1x8(quad.texture_matrix);
+            GX_Position3f32(x0, y1, z);
+            GX_TexCoord2f32(quad.uv.s0, quad.uv.t1);
+        }
+        GX_End();
+    }
+}
+
+/* Collects quads during draw_loop() and submits them as a few large
+ * GX_Begin runs. A run is broken whenever the texture or blend state
+ * changes, or when the buffer is full, so draw order is preserved.
+ *
+ * Positions are sent relative to an origin, which the position matrix
+ * translates back, so compact s16 vertices work anywhere in the world.
+ *
+ * Rotated or scaled quads get one of the spare position matrices, loaded
+ * when the batch is flushed, and pick it per vertex. They are drawn in
+ * the same run as everything else, until the matrices run out. */
+class SpriteBatch {
+public:
+    BatchQuad quads[BATCH_CAPACITY];
+    int count;
+    int origin_x;
+    int origin_y;
+    GXTexObj* texture;
+    BlendState blend;
+    Mtx transforms[BATCH_TRANSFORMS];
+    int transform_count;
+    int animated_count; // queued quads with a texture matrix
+    BatchStats stats;
+    BatchStats last_stats; // of the whole frame before, for readouts
+    SpriteBatch() {
+        this->count = 0;
+        this->transform_count = 0;
+        this->animated_count = 0;
+        this->origin_x = 0;
+        this->origin_y = 0;
+        this->texture = NULL;
+        this->blend = BLEND_ALPHA;
+        this->stats.reset();
+        this->last_stats.reset();
+    }
+    void begin_frame() {
+        this->last_stats = this->stats;
+        this->stats.reset();
+    }
+    /// Moves the origin positions are sent relative to. The position
+    /// matrix has to translate by the same amount.
+    void set_origin(int x, int y) {
+        this->flush();
+        this->origin_x = x;
+        this->origin_y = y;
+    }
+    /// Sets the state following quads are drawn with, flushing
+    /// everything queued under the previous state first.
+    void set_state(GXTexObj* texture, BlendState blend) {
+        if(texture == this->texture && blend == this->blend) return;
+        this->flush();
+        this->texture = texture;
+        this->blend = blend;
+    }
+    void add(int x0, int y0, int x1, int y1, int depth, const UV &uv) {
+        this->add(x0, y0, x1, y1, depth, uv, TEXMTX_STILL);
+    }
+    /// Adds a quad whose texture coordinates go through texture_matrix
+    void add(int x0, int y0, int x1, int y1, int depth, const UV &uv, u8 texture_matrix) {
+        if(this->count == BATCH_CAPACITY) this->flush();
+        BatchQuad &quad = this->quads[this->count++];
+        quad.x0 = x0;
+        quad.y0 = y0;
+        quad.x1 = x1;
+        quad.y1 = y1;
+        quad.depth = depth;
+        quad.matrix = GX_PNMTX0;
+        quad.texture_matrix = texture_matrix;
+        quad.uv = uv;
+        if(texture_matrix != TEXMTX_STILL) this->animated_count++;
+    }
+    /// Adds a quad rotated by rotation radians and scaled by scale around
+    /// center_x and center_y. x and y are relative to the center, so a
+    /// trimmed sprite still turns around the middle of the whole sprite.
+    void add_transformed(int center_x, int center_y, int x, int y, int width, int height, int depth,
+            const UV &uv, f32 rotation, f32 scale) {
+        if(this->count == BATCH_CAPACITY || this->transform_count == BATCH_TRANSFORMS) {
+            this->flush();
+        }
+        int slot = this->transform_count++;
+        Mtx scaling, rotate;
+        MtxP transform = this->transforms[slot];
+        guMtxScale(scaling, scale, scale, 1.0F);
+        guMtxRotRad(rotate, 'z', rotation);
+        guMtxConcat(rotate, scaling, transform);
+        guMtxTransApply(transform, transform, center_x, center_y, 0.0F);
+
+        BatchQuad &quad = this->quads[this->count++];
+        quad.x0 = x;
+        quad.y0 = y;
+        quad.x1 = x + width - 1;
+        quad.y1 = y + height - 1;
+        quad.depth = depth;
+        quad.matrix = GX_PNMTX1 + slot * (GX_PNMTX2 - GX_PNMTX1);
+        quad.texture_matrix = TEXMTX_STILL;
+        quad.uv = uv;
+    }
+    /// Flushes queued quads and loads the current state, so geometry
+    /// drawn outside of the batch is drawn with it too.
+    void bind() {
+        this->flush();
+        this->apply_state();
+    }
+    void flush() {
+        if(this->count == 0) return;
+        this->apply_state();
+
+        int bytes_per_vertex = vertex_size(vertex_mode);
+        if(this->animated_count > 0) {
+            render_state.set_vtx_desc(GX_VA_TEX0MTXIDX, GX_DIRECT);
+            bytes_per_vertex++;
+        }
+        if(this->transform_count > 0) {
+            for(int slot = 0; slot < this->transform_count; slot++) {
+                load_position_matrix(this->transforms[slot], GX_PNMTX1 + slot * (GX_PNMTX2 - GX_PNMTX1));
+            }
+            render_state.set_vtx_desc(GX_VA_PTNMTXIDX, GX_DIRECT);
+            emit_quads(this->quads, this->count, this->origin_x, this->origin_y);
+            render_state.set_vtx_desc(GX_VA_PTNMTXIDX, GX_NONE);
+            this->transform_count = 0;
+            bytes_per_vertex++;
+        } else {
+            emit_quads(this->quads, this->count, this->origin_x, this->origin_y);
+        }
+        if(this->animated_count > 0) {
+            render_state.set_vtx_desc(GX_VA_TEX0MTXIDX, GX_NONE);
+            this->animated_count = 0;
+        }
+
+        this->stats.quads += this->count;
+        this->stats.flushes++;
+        this->stats.bytes += this->count * 4 * bytes_per_vertex;
+        if(this->count > this->stats.largest_flush) {
+            this->stats.largest_flush = this->count;
+        }
+        this->count = 0;
+    }
+private:
+    void apply_state() {
+        if(this->texture != NULL) {
+            render_state.load_texture(this->texture, GX_TEXMAP0);
+        }
+        switch(this->blend) {
+            case BLEND_NONE:
+                render_state.set_blend_mode(GX_BM_NONE, GX_BL_ONE, GX_BL_ZERO, GX_LO_CLEAR);
+                render_state.set_alpha_compare(GX_ALWAYS, 0);
+                render_state.set_z_comp_loc(GX_TRUE);
+                break;
+            case BLEND_CUTOUT:
+                render_state.set_blend_mode(GX_BM_NONE, GX_BL_ONE, GX_BL_ZERO, GX_LO_CLEAR);
+                render_state.set_alpha_compare(GX_GEQUAL, CUTOUT_ALPHA);
+                // discarded texels must not write depth either
+                render_state.set_z_comp_loc(GX_FALSE);
+                break;
+            case BLEND_ALPHA:
+                render_state.set_blend_mode(GX_BM_BLEND, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
+                render_state.set_alpha_compare(GX_ALWAYS, 0);
+                render_state.set_z_comp_loc(GX_TRUE);
+                break;
+        }
+    }
+};
+
+SpriteBatch sprite_batch;
@@ -0,0 +1,191 @@
+/* Microbenchmarks for the draw path, run from console(), on the host
+ * with "make bench". Nothing they draw is displayed, GX is only set up
+ * so display lists can be recorded. On the host, draws include the shim
+ * executing what was sent. */
+
+#define BENCH_DRAWS 10000
+#define BENCH_FRAMES 100
+
+/* The texture coordinate lookup Sprite::draw() used before uv_table,
+ * kept so the two paths can be timed against each other. It addresses
+ * the grid of the old spritesheet, not the packed region textures
+ * uv_table points into. */
+class TexCoord {
+public:
+    tuple<double, double> topleft;
+    tuple<double, double> topright;
+    tuple<double, double> bottomright;
+    tuple<double, double> bottomleft;
+    /// Returns coordinates for where the image is located in memory
+    /// by the i'th and j'th position granted.
+    TexCoord(int i, int j) {
+        double x = (double)i;
+        double y = (double)j;
+        double dx = 1.0 / (IMAGE_WIDTH / WIDTH);
+        double dy = 1.0 / (IMAGE_HEIGHT / HEIGHT);
+        this->topleft = make_tuple(x * dx, y * dy);
+        this->topright = make_tuple(x * dx + dx, y * dy);
+        this->bottomright = make_tuple(x * dx + dx, y * dy + dy);
+        this->bottomleft = make_tuple(x * dx, y * dy + dy);
+    }
+};
+
+UV bench_uvs[BENCH_DRAWS];
+UV bench_reference[BENCH_DRAWS];
+
+u32 bench_texcoord_tuple() {
+    u64 start = gettime();
+    for(int n = 0; n < BENCH_DRAWS; n++) {
+        TexCoord coord(n % (IMAGE_WIDTH / WIDTH), (n / (IMAGE_WIDTH / WIDTH)) % (IMAGE_HEIGHT / HEIGHT));
+        UV &uv = bench_reference[n];
+        uv.s0 = get<0>(coord.topleft);
+        uv.t0 = get<1>(coord.topleft);
+        uv.s1 = get<0>(coord.bottomright);
+        uv.t1 = get<1>(coord.bottomright);
+    }
+    return diff_usec(start, gettime());
+}
+
+u32 bench_texcoord_table() {
+    u64 start = gettime();
+    for(int n = 0; n < BENCH_DRAWS; n++) {
+        bench_uvs[n] = sprite_uv((SpriteId)(n % SPRITE_COUNT));
+    }
+    return diff_usec(start, gettime());
+}
+
+void bench_setup_gx() {
+    void* fifo = memalign(32, DEFAULT_FIFO_SIZE);
+    memset(fifo, 0, DEFAULT_FIFO_SIZE);
+    GX_Init(fifo, DEFAULT_FIFO_SIZE);
+    render_state.forget();
+    setup_vertex_formats(USE_COMPACT_VERTICES ? VERTEX_COMPACT : VERTEX_FLOAT);
+    setup_terrain_arrays();
+    GX_ClearVtxDesc();
+    render_state.set_vtx_desc(GX_VA_POS, GX_DIRECT);
+    render_state.set_vtx_desc(GX_VA_TEX0, GX_DIRECT);
+    render_state.invalidate_vertex_cache();
+}
+
+struct TerrainBench {
+    u32 bake_us;
+    u32 frame_us;
+    int bytes_per_frame;
+    int texel_bytes_per_frame;
+};
+
+/// Times baking and drawing a 3x3 area of chunks in the given mode
+TerrainBench bench_terrain(TerrainMode mode) {
+    TerrainMode previous = terrain_mode;
+    terrain_mode = mode;
+    Area area(0);
+    View everything;
+    everything.right = 3 * CHUNK_SPACING;
+    everything.bottom = 3 * CHUNK_SPACING;
+    TerrainBench result = {};
+
+    u64 start = gettime();
+    for(Chunk &chunk : area.chunks) {
+        if(mode == TERRAIN_IMPOSTOR) {
+            chunk.capture();
+            result.bytes_per_frame += 4 * vertex_size(vertex_mode);
+            result.texel_bytes_per_frame += CHUNK_SPACING * CHUNK_SPACING * 2;
+        } else if(mode != TERRAIN_IMMEDIATE) {
+            chunk.bake();
+            result.bytes_per_frame += chunk.list_size;
+        }
+    }
+    GX_DrawDone();
+    result.bake_us = diff_usec(start, gettime());
+
+    start = gettime();
+    for(int frame = 0; frame < BENCH_FRAMES; frame++) {
+        sprite_batch.begin_frame();
+        render_queue.begin_frame();
+        render_queue.set_layer(LAYER_TERRAIN, BLEND_NONE, NULL);
+        area.capture(everything);
+        area.draw(everything);
+        render_queue.flush();
+        sprite_batch.flush();
+    }
+    GX_DrawDone();
+    result.frame_us = diff_usec(start, gettime()) / BENCH_FRAMES;
+    if(mode == TERRAIN_IMMEDIATE) {
+        result.bytes_per_frame = sprite_batch.stats.bytes;
+    }
+
+    terrain_mode = previous;
+    return result;
+}
+
+struct ParticleBench {
+    int particles;
+    u32 update_us;
+    u32 draw_us;
+};
+
+/// Times updating and drawing a full particle pool, respawning whatever
+/// dies so the pool stays full for every frame
+ParticleBench bench_particles() {
+    View everything;
+    everything.left = -SCREEN_WIDTH;
+    everything.top = -SCREEN_HEIGHT;
+    everything.right = 2 * SCREEN_WIDTH;
+    everything.bottom = 2 * SCREEN_HEIGHT;
+    ParticleBench result = {};
+    particles.clear();
+    sprite_batch.set_origin(0, 0);
+
+    u64 update_ticks = 0;
+    u64 draw_ticks = 0;
+    for(int frame = 0; frame < BENCH_FRAMES; frame++) {
+        while(particles.count < PARTICLE_CAPACITY) {
+            particles.spawn_sparks(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 64);
+        }
+        u64 start = gettime();
+        particles.update();
+        u64 middle = gettime();
+        particles.draw(everything);
+        GX_DrawDone();
+        update_ticks += middle - start;
+        draw_ticks += gettime() - middle;
+    }
+    result.particles = PARTICLE_CAPACITY;
+    result.update_us = ticks_to_microsecs(update_ticks) / BENCH_FRAMES;
+    result.draw_us = ticks_to_microsecs(draw_ticks) / BENCH_FRAMES;
+    particles.clear();
+    return result;
+}
+
+/* Prints the results of every benchmark, used by console() */
+void run_benchmarks() {
+    u32 tuple_us = bench_texcoord_tuple();
+    u32 table_us = bench_texcoord_table();
+    printf("texcoord, %d draws:\n", BENCH_DRAWS);
+    printf("    TexCoord tuple: %u us\n", tuple_us);
+    printf("    uv_table:       %u us\n", table_us);
+
+    printf("textures:\n");
+    printf("    glyphs  IA4    %3dx%3d\n", region_widths[REGION_GLYPHS], region_heights[REGION_GLYPHS]);
+    printf("    sprites RGB5A3 %3dx%3d\n", region_widths[REGION_SPRITES], region_heights[REGION_SPRITES]);
+    printf("    tiles   RGB565 %3dx%3d\n", region_widths[REGION_TILES], region_heights[REGION_TILES]);
+    printf("    %d bytes, %d as one RGBA8 sheet\n",
+            (int)(sizeof(glyphs_ia4) + sizeof(sprites_rgb5a3) + sizeof(tiles_rgb565)), IMAGE_WIDTH * IMAGE_HEIGHT * 4);
+
+    bench_setup_gx();
+    const char* names[] = { "immediate", "display list", "indexed", "impostor" };
+    TerrainMode modes[] = { TERRAIN_IMMEDIATE, TERRAIN_DISPLAY_LIST, TERRAIN_INDEXED, TERRAIN_IMPOSTOR };
+    printf("terrain, 3x3 chunks:\n");
+    for(int i = 0; i < 4; i++) {
+        TerrainBench result = bench_terrain(modes[i]);
+        printf("    %-12s bake %5u us, draw %5u us, %6d vertex bytes and %6d texel bytes per frame\n",
+                names[i], result.bake_us, result.frame_us, result.bytes_per_frame, result.texel_bytes_per_frame);
+    }
+
+    ParticleBench particle_result = bench_particles();
+    u32 particle_us = particle_result.update_us + particle_result.draw_us;
+    printf("particles, %d per frame:\n", particle_result.particles);
+    printf("    update %5u us, draw %5u us\n", particle_result.update_us, particle_result.draw_us);
+    printf("    %.1f million particles a second, %.1f%% of a 16.7 ms frame\n",
+            particle_us > 0 ? (double)particle_result.particles / particle_us : 0.0, particle_us / 166.67);
+}
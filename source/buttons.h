@@ -8,5 +8,5 @@
 
 #define BUTTON_START pressed & PAD_BUTTON_START
 
-#define STICK_X PAD_StickX(0)
-#define STICK_Y PAD_StickY(0)
\ No newline at end of file
+#define STICK_X(pad) PAD_StickX(pad)
+#define STICK_Y(pad) PAD_StickY(pad)
\ No newline at end of file
@@ -0,0 +1,107 @@
+/* Where the camera is, taken off every position matrix. The projection
+ * only changes with the size of the viewport, so scrolling never touches
+ * it, and since these are floats the camera can sit between pixels. */
+struct CameraTransform {
+    f32 x;
+    f32 y;
+    f32 depth; // pushed onto everything drawn, parallax layers sit further back
+};
+
+CameraTransform camera_transform = { 0, 0, 0 };
+
+/* Size of the area the projection shows, in pixels, 0 until one is loaded */
+f32 projection_width = 0;
+f32 projection_height = 0;
+
+/// Loads an orthographic projection showing width by height pixels from
+/// the camera, one pixel per world unit as long as the viewport is the
+/// same size. Split-screen viewports are all the same size, so only the
+/// first one of a frame has to send it.
+void load_projection(f32 width, f32 height) {
+    if(width == projection_width && height == projection_height) return;
+    Mtx44 projection;
+    guOrtho(projection, 0, height, 0, width, 0, DEPTH_FAR);
+    GX_LoadProjectionMtx(projection, GX_ORTHOGRAPHIC);
+    projection_width = width;
+    projection_height = height;
+}
+
+/// Moves the camera to x and y, position matrices loaded afterwards are
+/// seen from there
+void load_camera(f32 x, f32 y, f32 depth) {
+    camera_transform.x = x;
+    camera_transform.y = y;
+    camera_transform.depth = depth;
+}
+
+/// Loads the position matrix, translating every vertex by x and y and
+/// moving it depth further away from the camera
+void load_translation(f32 x, f32 y, f32 depth) {
+    Mtx model_view;
+    guMtxIdentity(model_view);
+    guMtxTransApply(model_view, model_view, x - camera_transform.x, y - camera_transform.y,
+            -(depth + camera_transform.depth));
+    GX_LoadPosMtxImm(model_view, GX_PNMTX0);
+}
+
+/// Loads a matrix placing something in the world into one of the
+/// position matrices, with the camera taken off
+void load_position_matrix(Mtx matrix, u32 index) {
+    Mtx model_view;
+    guMtxTransApply(matrix, model_view, -camera_transform.x, -camera_transform.y, -camera_transform.depth);
+    GX_LoadPosMtxImm(model_view, index);
+}
+
+/* Terrain scrolling at its own speed. Layer 0 is the world, the ones
+ * after it are drawn behind it and further away. They call the same
+ * chunk display lists as the world, only with their own camera matrix,
+ * so they cost no geometry of their own. Since only the chunks around
+ * the players are loaded, a layer scrolls around the chunk its player
+ * is in rather than the origin of the world. It shows through the small
+ * gaps chunks leave in the world while it is turned on. */
+struct ParallaxLayer {
+    f32 speed; // of the camera, compared to the world
+    f32 depth; // behind the world
+    f32 offset; // of its camera on both axes, so its gaps don't line up with the world's
+};
+
+#define PARALLAX_LAYERS (USE_PARALLAX_BACKDROP ? 2 : 1)
+#define BACKDROP_DEPTH 1000
+
+static_assert(DEPTH_TERRAIN + BACKDROP_DEPTH < DEPTH_FAR, "the backdrop has to stay in front of the far plane");
+
+ParallaxLayer parallax_layers[2] = {
+    { 1.0F, 0, 0 },                 // the world
+    { 0.5F, BACKDROP_DEPTH, 160 }   // a backdrop at half speed
+};
+
+class Camera {
+    public:
+        f32 x;
+        f32 y;
+        int width;  // of the viewport it draws to
+        int height;
+        int smoothing;
+        Camera() {
+            this->x = 0;
+            this->y = 0;
+            this->width = SCREEN_WIDTH;
+            this->height = SCREEN_HEIGHT;
+            this->smoothing = 20;
+        }
+        /// Eases towards the object, by fractions of a pixel once it's close
+        void follow_smooth(int object_x, int object_y) {
+            this->x += (object_x - (this->x + (this->width - 64) / 2.0F)) / this->smoothing;
+            this->y += (object_y - (this->y + (this->height - 64) / 2.0F)) / this->smoothing;
+            if(this->x < 0) this->x = 0;
+            if(this->y < 0) this->y = 0;
+        }
+        /// Whole pixel the camera is in, for culling and for the origin
+        /// quads are sent relative to
+        int pixel_x() {
+            return (int)floorf(this->x);
+        }
+        int pixel_y() {
+            return (int)floorf(this->y);
+        }
+};
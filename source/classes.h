@@ -1,9 +1,5 @@
 #include <vector>
 
-#define WIDTH 64
-#define HEIGHT 64
-
-class TexCoord;
 class Sprite;
 class Entity;
 class Projectile;
@@ -12,7 +8,6 @@ class Chunk;
 class Area;
 class Enemy;
 class Text;
-class Camera;
 class Spawner;
 class EnemySpawner;
 
@@ -21,53 +16,55 @@ enum Direction {
     LEFT, RIGHT
 };
 
-class TexCoord {
-public:
-    tuple<double, double> topleft;
-    tuple<double, double> topright;
-    tuple<double, double> bottomright;
-    tuple<double, double> bottomleft;
-    /// Returns coordinates for where the image is located in memory
-    /// by the i'th and j'th position granted.
-    TexCoord(int i, int j) {
-        double x = (double)i;
-        double y = (double)j;
-        double dx = 1.0 / (IMAGE_WIDTH / WIDTH);
-        double dy = 1.0 / (IMAGE_HEIGHT / HEIGHT);
-        this->topleft = make_tuple(x * dx, y * dy);
-        this->topright = make_tuple(x * dx + dx, y * dy);
-        this->bottomright = make_tuple(x * dx + dx, y * dy + dy);
-        this->bottomleft = make_tuple(x * dx, y * dy + dy);
-    }
-};
-
 class Sprite {
 public:
     int x;
     int y;
     int width;
     int height;
-    int i;
-    int j;
+    SpriteId id;
+    f32 rotation; // radians around the center, drawn by the GPU
+    f32 scale;
     Sprite() {
         this->x = 0;
         this->y = 0;
         this->width = WIDTH;
         this->height = HEIGHT;
-        this->i = 0;
-        this->j = 0;
+        this->id = SPRITE_WHITE;
+        this->rotation = 0.0F;
+        this->scale = 1.0F;
     }
-    Sprite(int x, int y, int width, int height, int i, int j) {
+    Sprite(int x, int y, int width, int height, SpriteId id) {
         this->x = x;
         this->y = y;
-        this->i = i;
-        this->j = j;
+        this->id = id;
         this->width = width;
         this->height = height;
+        this->rotation = 0.0F;
+        this->scale = 1.0F;
+    }
+    void set_texcoord(SpriteId id) {
+        this->id = id;
     }
-    void set_texcoord(int i, int j) {
-        this->i = i;
-        this->j = j;
+    bool transformed() {
+        return this->rotation != 0.0F || this->scale != 1.0F;
+    }
+    /// The box the sprite covers on screen, which grows to fit every
+    /// rotation when the sprite is transformed
+    void bounds(int &x, int &y, int &width, int &height) {
+        if(!this->transformed()) {
+            x = this->x;
+            y = this->y;
+            width = this->width;
+            height = this->height;
+            return;
+        }
+        // half the diagonal, rounded up
+        int radius = (int)(sqrtf(this->width * this->width + this->height * this->height) * this->scale * 0.5F) + 1;
+        x = this->x + this->width / 2 - radius;
+        y = this->y + this->height / 2 - radius;
+        width = 2 * radius;
+        height = 2 * radius;
     }
     bool isColliding(Sprite other) {
         int x1 = this->x;
@@ -89,22 +86,8 @@ public:
         return false;
     }
     void draw() {
-        int x = this->x;
-        int y = this->y;
-        int width = this->width;
-        int height = this->height;
-        TexCoord coord(this->i, this->j);
-
-        GX_Begin(GX_QUADS, GX_VTXFMT0, 4);
-        GX_Position2f32(x, y);
-        GX_TexCoord2f32(get<0>(coord.topleft), get<1>(coord.topleft));
-        GX_Position2f32(x + width - 1, y);
-        GX_TexCoord2f32(get<0>(coord.topright), get<1>(coord.topright));
-        GX_Position2f32(x + width - 1, y + height - 1);
-        GX_TexCoord2f32(get<0>(coord.bottomright), get<1>(coord.bottomright));
-        GX_Position2f32(x, y + height - 1);
-        GX_TexCoord2f32(get<0>(coord.bottomleft), get<1>(coord.bottomleft));
-        GX_End();
+        render_queue.push(this->x, this->y, this->width, this->height, this->id,
+                this->rotation, this->scale);
     }
 };
 
@@ -112,11 +95,24 @@ public:
 class Entity {
 	public:
 		Sprite sprite;
+		Palette palette = PALETTE_BASE;
 
         virtual ~Entity() {}
 		void draw() {
 			this->sprite.draw();
 		}
+		/* Draws the entity only if the view can see it */
+		void draw(View &view) {
+			int x, y, width, height;
+			this->sprite.bounds(x, y, width, height);
+			if(!view.overlaps(x, y, width, height)) {
+				view.stats.sprites_culled++;
+				return;
+			}
+			view.stats.sprites_drawn++;
+			render_queue.set_texture(palette_texture(this->palette));
+			this->sprite.draw();
+		}
 		int getX() {
 			return this->sprite.x;
 		}
@@ -147,7 +143,7 @@ class Projectile : public Entity {
         Entity* projectileOwner; 
 
     Projectile() {
-        this->sprite = Sprite(100, 480 / 2, 64, 64, FLAME_SPRITE);
+        this->sprite = Sprite(100, 480 / 2, 64, 64, SPRITE_FLAME);
     }
 
     Projectile(Direction d, int x, int y) : Projectile() {
@@ -164,6 +160,10 @@ class Projectile : public Entity {
             move(-speed, 0);
         }
         travelDistance += speed;
+        // flames spin as they fly
+        this->sprite.rotation = fmodf(this->sprite.rotation + 0.3F, 2.0F * M_PI);
+        int vx = this->direction == RIGHT ? speed : -speed;
+        particles.spawn_trail(getX() + this->sprite.width / 2, getY() + this->sprite.height / 2, vx);
     }
 
     bool isDead() {
@@ -188,9 +188,11 @@ class Player: public Entity {
         int attackSpeed = 30; 
 
 		Direction direction = Direction::RIGHT;
+		int pad; // controller port the player plays on
 
 		Player() {
-			this->sprite = Sprite(100, 480 / 2, 64, 64, PLAYER_RIGHT_SPRITE);
+			this->sprite = Sprite(100, 480 / 2, 64, 64, SPRITE_PLAYER_RIGHT);
+			this->pad = 0;
 			this->health = 10;
 			this->damage = 5;
 			this->xp = 0;
@@ -216,7 +218,7 @@ class Player: public Entity {
         
         void act() {
 			// Has to be declared each frame AND right here
-			u16 pressed = PAD_ButtonsHeld(0);
+			u16 pressed = PAD_ButtonsHeld(this->pad);
 
 			if (BUTTON_START) exit(0);
 
@@ -224,8 +226,8 @@ class Player: public Entity {
                 decreaseAttackTimer();
             }
 
-			double dx = STICK_X / 64.0;
-			double dy = STICK_Y / 64.0;
+			double dx = STICK_X(this->pad) / 64.0;
+			double dy = STICK_Y(this->pad) / 64.0;
             
             if (BUTTON_A && pressed && canAttack()) {
                 Projectile* to_shoot = new Projectile(this->direction, getX(), getY());
@@ -256,142 +258,435 @@ class Player: public Entity {
 			switch(direction) {
 				case Direction::LEFT:
 					if(animation_timer < 10) {
-						sprite.set_texcoord(PLAYER_LEFT_SPRITE);
+						sprite.set_texcoord(SPRITE_PLAYER_LEFT);
 					} else {
-						sprite.set_texcoord(PLAYER_LEFT_WALK_SPRITE);
+						sprite.set_texcoord(SPRITE_PLAYER_LEFT_WALK);
 					}
 					break;
 				case Direction::RIGHT:
 					if(animation_timer < 10) {
-						sprite.set_texcoord(PLAYER_RIGHT_SPRITE);
+						sprite.set_texcoord(SPRITE_PLAYER_RIGHT);
 					} else {
-						sprite.set_texcoord(PLAYER_RIGHT_WALK_SPRITE);
+						sprite.set_texcoord(SPRITE_PLAYER_RIGHT_WALK);
 					}
 					break;
 			}
 		}
 };
 
-#define CHUNK_SIZE 6
-#define CHUNK_SPACING 64 * CHUNK_SIZE
 class Chunk {
 public:
     Sprite blocks[CHUNK_SIZE][CHUNK_SIZE];
+    bool gaps[CHUNK_SIZE][CHUNK_SIZE]; // left out of the display list, so the backdrop shows
+    int gap_count;
     int origin_x;
     int origin_y;
     int seed;
+    void* list;
+    u32 list_size;
+    u32 part_offsets[CHUNK_PARTS]; // where each part starts in the list
+    u32 part_sizes[CHUNK_PARTS];   // 0 for parts that are all gaps
+    int impostor;
     Chunk() {
         origin_x = 0;
         origin_y = 0;
         seed = 0;
+        gap_count = 0;
+        list = NULL;
+        list_size = 0;
+        impostor = -1;
     }
     Chunk(int origin_x, int origin_y, int seed) {
         this->seed = seed;
         this->origin_x = origin_x;
         this->origin_y = origin_y;
+        this->list = NULL;
+        this->list_size = 0;
+        this->impostor = -1;
+        this->gap_count = 0;
         FastNoiseLite noise(this->seed);
         noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+        // much finer than the terrain, so the gaps are small holes the
+        // backdrop almost always has a tile behind
+        FastNoiseLite gap_noise(this->seed + 1);
+        gap_noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+        gap_noise.SetFrequency(CHUNK_GAP_FREQUENCY);
         for(int i = 0; i < CHUNK_SIZE; i++) {
             for(int j = 0; j < CHUNK_SIZE; j++) {
                 this->blocks[i][j].x = this->origin_x * CHUNK_SPACING + i * 64;
                 this->blocks[i][j].y = this->origin_y * CHUNK_SPACING + j * 64;
                 float value = noise.GetNoise((float)(origin_x * CHUNK_SIZE + i), (float)(origin_y * CHUNK_SIZE + j));
                 if(value > -0.25) {
-                    this->blocks[i][j].set_texcoord(GRASS_SPRITE);
+                    this->blocks[i][j].set_texcoord(SPRITE_GRASS);
                 } else if(value > -0.35) {
-                    this->blocks[i][j].set_texcoord(STONE_SPRITE);
+                    this->blocks[i][j].set_texcoord(SPRITE_STONE);
                 } else {
-                    this->blocks[i][j].set_texcoord(WATER_SPRITE);
+                    this->blocks[i][j].set_texcoord(SPRITE_WATER);
                 }
-
+                // the tile stays for the minimap, and for tiles drawn one
+                // by one, which have no backdrop behind them
+                float gap = gap_noise.GetNoise((float)(origin_x * CHUNK_SIZE + i), (float)(origin_y * CHUNK_SIZE + j));
+                this->gaps[i][j] = USE_PARALLAX_BACKDROP && gap > CHUNK_GAP_NOISE;
+                if(this->gaps[i][j]) this->gap_count++;
             }
         }
     }
-    void draw() {
+    /// Writes the tiles into the minimap, done once when the chunk joins
+    /// the area since they never change after
+    void chart() {
+        SpriteId tiles[CHUNK_SIZE][CHUNK_SIZE];
+        for(int i = 0; i < CHUNK_SIZE; i++) {
+            for(int j = 0; j < CHUNK_SIZE; j++) {
+                tiles[i][j] = this->blocks[i][j].id;
+            }
+        }
+        minimap.chart(this->origin_x * CHUNK_SIZE, this->origin_y * CHUNK_SIZE, tiles);
+    }
+    // a chunk owns its display list and impostor, so it can be moved but not copied
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+    Chunk(Chunk&& other) noexcept {
+        this->list = NULL;
+        this->impostor = -1;
+        *this = std::move(other);
+    }
+    Chunk& operator=(Chunk&& other) noexcept {
+        if(this == &other) return *this;
+        chunk_lists.release(this->list);
+        impostors.release(this->impostor);
+        for(int i = 0; i < CHUNK_SIZE; i++) {
+            for(int j = 0; j < CHUNK_SIZE; j++) {
+                this->blocks[i][j] = other.blocks[i][j];
+                this->gaps[i][j] = other.gaps[i][j];
+            }
+        }
+        this->gap_count = other.gap_count;
+        this->origin_x = other.origin_x;
+        this->origin_y = other.origin_y;
+        this->seed = other.seed;
+        this->list = other.list;
+        this->list_size = other.list_size;
+        for(int part = 0; part < CHUNK_PARTS; part++) {
+            this->part_offsets[part] = other.part_offsets[part];
+            this->part_sizes[part] = other.part_sizes[part];
+        }
+        this->impostor = other.impostor;
+        other.list = NULL;
+        other.list_size = 0;
+        other.impostor = -1;
+        return *this;
+    }
+    ~Chunk() {
+        chunk_lists.release(this->list);
+        impostors.release(this->impostor);
+    }
+    /// Whether the chunk is nothing but gaps, with nothing to bake
+    bool open() {
+        return this->gap_count == CHUNK_SIZE * CHUNK_SIZE;
+    }
+    int world_x() {
+        return this->origin_x * CHUNK_SPACING;
+    }
+    int world_y() {
+        return this->origin_y * CHUNK_SPACING;
+    }
+    /// Records the chunk into a display list, with positions relative
+    /// to the chunk so they stay small enough for compact vertices. Each
+    /// part is recorded as its own run, 32-byte aligned so it can be
+    /// called alone, and the padding between them is only NOPs so the
+    /// whole list can be called at once too.
+    void bake() {
+        if(this->list != NULL || this->open()) return;
+        this->list = chunk_lists.acquire();
+        // recorded with the descriptor it is called with, Area::draw
+        // already has it set when a chunk is baked while drawing
+        bool outside = render_state.vtx_desc[GX_VA_TEX0MTXIDX] != GX_DIRECT;
+        if(outside) begin_terrain();
+        this->list_size = 0;
+        for(int part = 0; part < CHUNK_PARTS; part++) {
+            this->part_offsets[part] = this->list_size;
+            this->part_sizes[part] = 0;
+            int left = (part % CHUNK_PARTS_ACROSS) * CHUNK_PART_SIZE;
+            int top = (part / CHUNK_PARTS_ACROSS) * CHUNK_PART_SIZE;
+            int tiles = 0;
+            for(int i = left; i < left + CHUNK_PART_SIZE; i++) {
+                for(int j = top; j < top + CHUNK_PART_SIZE; j++) {
+                    if(!this->gaps[i][j]) tiles++;
+                }
+            }
+            if(tiles == 0) continue;
+            void* start = (u8*)this->list + this->list_size;
+            u32 size = record_display_list(start, chunk_lists.size - this->list_size, [&]() {
+                this->emit_part(left, top, tiles);
+            });
+            if(size == 0) {
+                this->list_size = 0;
+                break;
+            }
+            this->part_sizes[part] = size;
+            this->list_size += size;
+        }
+        if(outside) end_terrain();
+        // didn't fit, fall back to drawing tile by tile
+        if(this->list_size == 0) {
+            chunk_lists.release(this->list);
+            this->list = NULL;
+        }
+    }
+    /// Renders the chunk into an impostor texture, after which its
+    /// display list isn't needed anymore
+    void capture() {
+        if(this->impostor >= 0) return;
+        // impostors are opaque, they would cover the gaps up
+        if(this->gap_count > 0) return;
+        this->bake();
+        if(this->list == NULL) return;
+        this->impostor = impostors.acquire();
+        if(this->impostor < 0) return;
+        impostors.capture(this->impostor, this->list, this->list_size);
+        chunk_lists.release(this->list);
+        this->list = NULL;
+        this->list_size = 0;
+    }
+    void draw(View &view) {
+        if(!view.overlaps(this->world_x(), this->world_y(), CHUNK_SPACING, CHUNK_SPACING)) {
+            view.stats.chunks_culled++;
+            return;
+        }
+        view.stats.chunks_drawn++;
+        if(this->impostor >= 0) {
+            load_translation(this->world_x(), this->world_y(), DEPTH_TERRAIN);
+            impostors.draw(this->impostor);
+            return;
+        }
+        if(terrain_mode != TERRAIN_IMMEDIATE) {
+            if(this->open()) return;
+            this->bake();
+        }
+        if(this->list != NULL) {
+            // an impostor chunk only gets here if it ran out of impostors
+            if(terrain_mode == TERRAIN_IMPOSTOR) begin_terrain();
+            load_translation(this->world_x(), this->world_y(), DEPTH_TERRAIN);
+            if(view.contains(this->world_x(), this->world_y(), CHUNK_SPACING, CHUNK_SPACING)) {
+                GX_CallDispList(this->list, this->list_size);
+            } else {
+                this->draw_parts(view);
+            }
+            if(terrain_mode == TERRAIN_IMPOSTOR) end_terrain();
+            return;
+        }
+        // only tiles of chunks on the edge of the screen need checking
+        bool inside = view.contains(this->world_x(), this->world_y(), CHUNK_SPACING, CHUNK_SPACING);
         for(int i = 0; i < CHUNK_SIZE; i++) {
             for(int j = 0; j < CHUNK_SIZE; j++) {
-                this->blocks[i][j].draw();
+                Sprite &block = this->blocks[i][j];
+                if(!inside && !view.overlaps(block.x, block.y, block.width, block.height)) {
+                    view.stats.tiles_culled++;
+                    continue;
+                }
+                view.stats.tiles_drawn++;
+                block.draw();
             }
         }
     }
+private:
+    /// Sends the tiles of the part starting at tile left, top
+    void emit_part(int left, int top, int tiles) {
+        if(terrain_indexed()) {
+            GX_Begin(GX_QUADS, VTXFMT_INDEXED, tiles * 4);
+            for(int i = left; i < left + CHUNK_PART_SIZE; i++) {
+                for(int j = top; j < top + CHUNK_PART_SIZE; j++) {
+                    if(this->gaps[i][j]) continue;
+                    emit_indexed_tile(i, j, this->blocks[i][j].id);
+                }
+            }
+            GX_End();
+            return;
+        }
+        BatchQuad quads[CHUNK_PART_SIZE * CHUNK_PART_SIZE];
+        int count = 0;
+        for(int i = left; i < left + CHUNK_PART_SIZE; i++) {
+            for(int j = top; j < top + CHUNK_PART_SIZE; j++) {
+                if(this->gaps[i][j]) continue;
+                Sprite &block = this->blocks[i][j];
+                BatchQuad &quad = quads[count++];
+                quad.x0 = block.x;
+                quad.y0 = block.y;
+                quad.x1 = block.x + block.width - 1;
+                quad.y1 = block.y + block.height - 1;
+                quad.depth = 0;
+                quad.matrix = GX_PNMTX0;
+                quad.texture_matrix = tile_texture_matrix(block.id);
+                quad.uv = sprite_uv(block.id);
+            }
+        }
+        emit_quads(quads, count, this->world_x(), this->world_y());
+    }
+    /// Calls the parts of the list the view can see
+    void draw_parts(View &view) {
+        for(int part = 0; part < CHUNK_PARTS; part++) {
+            if(this->part_sizes[part] == 0) continue;
+            int x = this->world_x() + (part % CHUNK_PARTS_ACROSS) * CHUNK_PART_SPACING;
+            int y = this->world_y() + (part / CHUNK_PARTS_ACROSS) * CHUNK_PART_SPACING;
+            if(!view.overlaps(x, y, CHUNK_PART_SPACING, CHUNK_PART_SPACING)) {
+                view.stats.parts_culled++;
+                continue;
+            }
+            GX_CallDispList((u8*)this->list + this->part_offsets[part], this->part_sizes[part]);
+        }
+    }
 };
 
+/* Keeps the 3x3 chunks around every player generated and baked. A chunk
+ * near more than one player is still only stored and baked once, every
+ * viewport draws the same one. */
 class Area {
     public:
         int seed;
-        tuple<int, int> bounds_x;
-        tuple<int, int> bounds_y;
-        vector<vector<Chunk>> chunks;
+        vector<Chunk> chunks; // in use by at least one player
+        vector<Chunk> spare;  // generated ahead of time, or recently left behind
+        int centers_x[MAX_PLAYERS]; // chunk each player is in
+        int centers_y[MAX_PLAYERS];
+        int center_count;
         Area(int seed) {
             this->seed = seed;
-            for(int j = 0; j < 3; j++) {
-                vector<Chunk> temp_chunks;
-                for(int i = 0; i < 3; i++) {
-                    Chunk chunk(i, j, this->seed);
-                    temp_chunks.push_back(chunk);
+            this->center_count = 1;
+            this->centers_x[0] = 1;
+            this->centers_y[0] = 1;
+            // GX may not be up yet, the first draw bakes them
+            this->fill(false);
+        }
+        /// Moves the chunks along with count players at x[n] and y[n]
+        void update(const int x[], const int y[], int count) {
+            bool moved = count != this->center_count;
+            for(int n = 0; n < count; n++) {
+                // the 3x3 never reaches past the origin of the world
+                int center_x = std::max(1, x[n] / CHUNK_SPACING);
+                int center_y = std::max(1, y[n] / CHUNK_SPACING);
+                moved = moved || center_x != this->centers_x[n] || center_y != this->centers_y[n];
+                this->centers_x[n] = center_x;
+                this->centers_y[n] = center_y;
+            }
+            this->center_count = count;
+            if(!moved) return;
+
+            // chunks nobody is near anymore are kept around for a while,
+            // in case someone turns back
+            for(size_t n = 0; n < this->chunks.size();) {
+                if(this->near(this->chunks[n].origin_x, this->chunks[n].origin_y, 1)) {
+                    n++;
+                    continue;
                 }
-                this->chunks.push_back(temp_chunks);
+                this->spare.push_back(std::move(this->chunks[n]));
+                this->chunks.erase(this->chunks.begin() + n);
             }
-            int temp_x = this->chunks[1][1].origin_x * CHUNK_SPACING;
-            int temp_y = this->chunks[1][1].origin_y * CHUNK_SPACING;
-            this->bounds_x = make_tuple(temp_x, temp_x + CHUNK_SPACING);
-            this->bounds_y = make_tuple(temp_y, temp_y + CHUNK_SPACING);
-
-        }
-        void update(int x, int y) {
-            bool new_bounds = false;
-            if((x < get<0>(bounds_x)) && this->chunks[0][0].origin_x > 0) {
-                new_bounds = true;
-                for(int i = 0; i < 3; i++) {
-                    this->chunks[i].erase(this->chunks[i].begin() + 2);
-                    int origin_x = this->chunks[i][0].origin_x;
-                    int origin_y = this->chunks[i][0].origin_y;
-                    Chunk chunk(origin_x - 1, origin_y, this->seed);
-                    this->chunks[i].insert(this->chunks[i].begin(), chunk);
+            this->fill(terrain_mode != TERRAIN_IMMEDIATE);
+            this->drop_distant_spares();
+        }
+        /// Generates and bakes the chunks update() would need next, the
+        /// ones bordering the 3x3 around each player, until gettime()
+        /// passes deadline. Returns how many chunks it generated.
+        int pregenerate(u64 deadline) {
+            int generated = 0;
+            for(int c = 0; c < this->center_count; c++) {
+                for(int j = -2; j <= 2; j++) {
+                    for(int i = -2; i <= 2; i++) {
+                        // the corners are never entered straight from the center
+                        if(abs(i) != 2 && abs(j) != 2) continue;
+                        if(abs(i) == 2 && abs(j) == 2) continue;
+                        int origin_x = this->centers_x[c] + i;
+                        int origin_y = this->centers_y[c] + j;
+                        if(origin_x < 0 || origin_y < 0) continue;
+                        if(this->find(this->chunks, origin_x, origin_y) >= 0) continue;
+                        if(this->find(this->spare, origin_x, origin_y) >= 0) continue;
+                        if(gettime() >= deadline) return generated;
+                        Chunk chunk(origin_x, origin_y, this->seed);
+                        if(terrain_mode != TERRAIN_IMMEDIATE) chunk.bake();
+                        this->spare.push_back(std::move(chunk));
+                        generated++;
+                    }
                 }
-            } else if(x > get<1>(bounds_x)) {
-                new_bounds = true;
-                for(int i = 0; i < 3; i++) {
-                    this->chunks[i].erase(this->chunks[i].begin());
-                    int origin_x = this->chunks[i][1].origin_x;
-                    int origin_y = this->chunks[i][1].origin_y;
-                    Chunk chunk(origin_x + 1, origin_y, this->seed);
-                    this->chunks[i].push_back(chunk);
+            }
+            return generated;
+        }
+        /// Renders impostors for the chunks the view can see that don't
+        /// have one yet. Has to run before anything else is drawn in the
+        /// frame, with the viewport covering the whole screen.
+        void capture(View &view) {
+            if(terrain_mode != TERRAIN_IMPOSTOR) return;
+            for(Chunk &chunk : this->chunks) {
+                if(view.overlaps(chunk.world_x(), chunk.world_y(), CHUNK_SPACING, CHUNK_SPACING)) {
+                    chunk.capture();
                 }
-            } else if((y < get<0>(bounds_y)) && this->chunks[0][0].origin_y > 0) {
-                new_bounds = true;
-                this->chunks.erase(this->chunks.begin() + 2);
-                vector<Chunk> temp_chunks;
-                for(int i = 0; i < 3; i++) {
-                    int origin_x = this->chunks[0][i].origin_x;
-                    int origin_y = this->chunks[0][i].origin_y;
-                    Chunk chunk(origin_x, origin_y - 1, this->seed);
-                    temp_chunks.push_back(chunk);
+            }
+            render_state.invalidate_textures();
+        }
+        void draw(View &view) {
+            // display lists don't go through the batch, so it has to be
+            // flushed and its state loaded before they are called
+            sprite_batch.set_state(&region_textures[REGION_TILES], BLEND_NONE);
+            sprite_batch.bind();
+            bool lists = terrain_mode == TERRAIN_INDEXED || terrain_mode == TERRAIN_DISPLAY_LIST;
+            if(lists) begin_terrain();
+            for(Chunk &chunk : this->chunks) {
+                chunk.draw(view);
+            }
+            if(lists) end_terrain();
+            load_translation(sprite_batch.origin_x, sprite_batch.origin_y, 0);
+        }
+    private:
+        /// Whether some player's chunk is at most distance chunks away
+        bool near(int origin_x, int origin_y, int distance) {
+            for(int c = 0; c < this->center_count; c++) {
+                if(abs(origin_x - this->centers_x[c]) <= distance && abs(origin_y - this->centers_y[c]) <= distance) {
+                    return true;
                 }
-                this->chunks.insert(this->chunks.begin(), temp_chunks);
-            } else if(y > get<1>(bounds_y)) {
-                new_bounds = true;
-                this->chunks.erase(this->chunks.begin());
-                vector<Chunk> temp_chunks;
-                for(int i = 0; i < 3; i++) {
-                    int origin_x = this->chunks[1][i].origin_x;
-                    int origin_y = this->chunks[1][i].origin_y;
-                    Chunk chunk(origin_x, origin_y + 1, this->seed);
-                    temp_chunks.push_back(chunk);
+            }
+            return false;
+        }
+        int find(vector<Chunk> &list, int origin_x, int origin_y) {
+            for(size_t n = 0; n < list.size(); n++) {
+                if(list[n].origin_x == origin_x && list[n].origin_y == origin_y) return n;
+            }
+            return -1;
+        }
+        /// Brings in every chunk of the 3x3 around each player that isn't
+        /// in use yet, from the spares if it was generated before
+        void fill(bool bake) {
+            for(int c = 0; c < this->center_count; c++) {
+                for(int j = -1; j <= 1; j++) {
+                    for(int i = -1; i <= 1; i++) {
+                        int origin_x = this->centers_x[c] + i;
+                        int origin_y = this->centers_y[c] + j;
+                        if(this->find(this->chunks, origin_x, origin_y) >= 0) continue;
+                        this->chunks.push_back(this->take(origin_x, origin_y));
+                        // bake the freshly generated chunks right away
+                        if(bake) this->chunks.back().bake();
+                    }
                 }
-                this->chunks.push_back(temp_chunks);
             }
-            if(new_bounds) {
-                int temp_x = this->chunks[1][1].origin_x * CHUNK_SPACING;
-                int temp_y = this->chunks[1][1].origin_y * CHUNK_SPACING;
-                this->bounds_x = make_tuple(temp_x, temp_x + CHUNK_SPACING);
-                this->bounds_y = make_tuple(temp_y, temp_y + CHUNK_SPACING);
+        }
+        /// The chunk at origin_x and origin_y, pregenerated if it was,
+        /// charted into the minimap as it joins the area
+        Chunk take(int origin_x, int origin_y) {
+            int n = this->find(this->spare, origin_x, origin_y);
+            if(n < 0) {
+                Chunk chunk(origin_x, origin_y, this->seed);
+                chunk.chart();
+                return chunk;
             }
+            Chunk chunk(std::move(this->spare[n]));
+            this->spare.erase(this->spare.begin() + n);
+            chunk.chart();
+            return chunk;
         }
-        void draw() {
-            for(int i = 0; i < 3; i++) {
-                for(int j = 0; j < 3; j++) {
-                    this->chunks[i][j].draw();
+        /// Spares stop being useful once every player moved away from them
+        void drop_distant_spares() {
+            for(size_t n = 0; n < this->spare.size();) {
+                if(this->near(this->spare[n].origin_x, this->spare[n].origin_y, 2)) {
+                    n++;
+                } else {
+                    this->spare.erase(this->spare.begin() + n);
                 }
             }
         }
@@ -399,13 +694,30 @@ class Area {
 
 class Enemy: public Entity {
 	public:
+		int hit_timer = 0; // frames left of the hit flash
+		Palette tier;
+
 		Enemy() {
-			this->sprite = Sprite(rand() % 500, rand() % 500, 64, 64, ENEMY_SPRITE);
+			this->sprite = Sprite(rand() % 500, rand() % 500, 64, 64, SPRITE_ENEMY);
+			// tougher tiers are rarer
+			int roll = rand() % 10;
+			this->tier = roll < 6 ? PALETTE_BASE : roll < 9 ? PALETTE_ELITE : PALETTE_CHAMPION;
+			this->palette = this->tier;
 		}
 
         void act() {
             this->sprite.x += (5 - rand() % 11);
             this->sprite.y += (5 - rand() % 11);
+            if (this->hit_timer > 0) {
+                this->hit_timer--;
+            }
+            // swell up when hit and shrink back
+            this->sprite.scale = 1.0F + this->hit_timer * 0.04F;
+            this->palette = this->hit_timer > 0 ? PALETTE_FLASH : this->tier;
+        }
+
+        void handleProjectile(Projectile* p) {
+            this->hit_timer = 10;
         }
 
 		void act(Player player) {
@@ -429,85 +741,145 @@ class Enemy: public Entity {
 #define TEXT_BIG 64
 #define TEXT_MEDIUM 48
 #define TEXT_SMALL 32
+/* A line of text drawn from the glyph table, stored inline so
+ * building one every frame never touches the heap */
 class Text {
 public:
-    vector<Sprite> letters;
-    Text(string text, int x, int y, int size) {
-        int index = 0;
-        int spacing = (int)(size * 0.8);
-        // this loops over each letter and creates a sprite
-        // based on the letter ascii value and translates its value
-        // into coordinate in spritesheet
-        for (char letter: text) {
-            int ascii = (int)letter;
-            int i = 0;
-            int j = 0;
-            // if it's digit
-            if(ascii <= '9') {
-                // if it's space
-                if(ascii == ' ') {
-                    i = 12;
-                    j = 3;
-                } else {
-                    i = ascii - 48;
-                }
-                // otherwise letters
-            } else {
-                j++;
-                if(ascii > 'M') {
-                    j++;
-                }
-                i = (ascii - 'A') % 13;
-            }
-            Sprite sprite = Sprite(x + index * spacing, y, size, size, i, j);
-            this->letters.push_back(sprite);
-            index++;
-        }
+    TextBuffer text;
+    int x;
+    int y;
+    int size;
+    Text(const TextBuffer &text, int x, int y, int size) {
+        this->text = text;
+        this->x = x;
+        this->y = y;
+        this->size = size;
     }
     void draw() {
-        for (Sprite &letter: this->letters) {
-            letter.draw();
-        }
+        layout_text(this->text.chars, this->x, this->y, this->size,
+                [](int x, int y, int width, int height, SpriteId id) {
+            render_queue.push(x, y, width, height, id);
+        });
+    }
+    void build(HudBuilder &builder) {
+        layout_text(this->text.chars, this->x, this->y, this->size,
+                [&](int x, int y, int width, int height, SpriteId id) {
+            builder.add(x, y, width, height, id);
+        });
     }
 };
 
-class Camera {
-    public:
-        int x;
-        int y;
-        int smoothing;
-        Camera() {
-            this->x = 0;
-            this->y = 0;
-            this->smoothing = 20;
-        }
-        void follow_smooth(int object_x, int object_y) {
-            this->x += (object_x - (this->x + (SCREEN_WIDTH - 64) / 2)) / this->smoothing;
-            this->y += (object_y - (this->y + (SCREEN_HEIGHT - 64) / 2)) / this->smoothing;
-            if(this->x < 0) this->x = 0;
-            if(this->y < 0) this->y = 0;
-        }
-};
-
+/* The HUD, kept as display lists in screen coordinates that are only
+ * rebuilt when the entity count or the pause state changes */
 class Gui {
     public:
-        int camera_x;
-        int camera_y;
-        Gui(int camera_x, int camera_y) {
-            this->camera_x = camera_x;
-            this->camera_y = camera_y;
+        HudWidget dashboard;
+        HudWidget counter;
+        HudWidget pause_band;
+        HudWidget pause_label;
+        HudWidget map;
+        Gui() : dashboard(BLEND_ALPHA), counter(BLEND_CUTOUT),
+                pause_band(BLEND_NONE), pause_label(BLEND_CUTOUT), map(BLEND_NONE) {}
+        void draw(bool paused, u32 entity_count, int player_x, int player_y) {
+            if(!paused) {
+                this->dashboard.update(80, [](HudBuilder &builder) {
+                    draw_dashboard(builder, 80);
+                });
+                this->counter.update(entity_count, [entity_count](HudBuilder &builder) {
+                    Text(TextBuffer().append((int)entity_count), 10, 10, TEXT_MEDIUM).build(builder);
+                });
+                // only rebuilt when the player steps onto another tile
+                int tile_x = player_x / WIDTH;
+                int tile_y = player_y / HEIGHT;
+                this->map.update((u32)tile_y << 16 | (tile_x & 0xffff), [tile_x, tile_y](HudBuilder &builder) {
+                    int size = MINIMAP_VIEW * MINIMAP_SCALE;
+                    minimap.build(builder, SCREEN_WIDTH - size - 20, 90, tile_x, tile_y);
+                });
+                this->dashboard.draw();
+                this->counter.draw();
+                this->map.draw();
+            } else {
+                // the frozen frame shows around a band behind the label
+                this->dashboard.update(80, [](HudBuilder &builder) {
+                    draw_dashboard(builder, 80);
+                });
+                this->pause_band.update(0, [](HudBuilder &builder) {
+                    builder.add(-10, SCREEN_HEIGHT / 2 - 48, SCREEN_WIDTH + 20, 96, SPRITE_WHITE);
+                });
+                this->pause_label.update(0, [](HudBuilder &builder) {
+                    Text("PAUSED", 160, SCREEN_HEIGHT / 2 - 32, TEXT_BIG).build(builder);
+                });
+                this->dashboard.draw();
+                this->pause_band.draw();
+                this->pause_label.draw();
+            }
+        }
+        /// Frame time, player position and what the viewport culled last
+        /// frame, rebuilt every frame, so they go through the render queue
+        /// instead of a display list
+        void draw_debug(int camera_x, int camera_y, int player_x, int player_y,
+                const CullStats &culled, u32 viewport_us) {
+            render_queue.set_layer(LAYER_HUD, BLEND_CUTOUT, NULL);
+            TextBuffer line;
+            line.append("us ").append((int)frame_pacer.frame_us).append(" view ").append((int)viewport_us);
+            Text(line, camera_x + 10, camera_y + 90, TEXT_SMALL).draw();
+            line.clear();
+            line.append("x ").append(player_x).append(" y ").append(player_y);
+            Text(line, camera_x + 10, camera_y + 120, TEXT_SMALL).draw();
+            line.clear();
+            line.append("c ").append(culled.chunks_drawn).append("|").append(culled.chunks_culled);
+            line.append("|").append(culled.parts_culled);
+            line.append(" s ").append(culled.sprites_drawn).append("|").append(culled.sprites_culled);
+            Text(line, camera_x + 10, camera_y + 150, TEXT_SMALL).draw();
+            // the counters of the whole frame before, this one isn't done yet
+            BatchStats &batch = sprite_batch.last_stats;
+            line.clear();
+            line.append("q ").append((f32)batch.quads_per_flush(), 1).append(" f ").append(batch.flushes);
+            line.append(" max ").append(batch.largest_flush);
+            Text(line, camera_x + 10, camera_y + 180, TEXT_SMALL).draw();
+            line.clear();
+            line.append("kb ").append(batch.bytes / 1024.0F, 1);
+            line.append(" st ").append(render_state.last_stats.issued).append("|").append(render_state.last_stats.elided);
+            Text(line, camera_x + 10, camera_y + 210, TEXT_SMALL).draw();
+            line.clear();
+            line.append("sort ").append(render_queue.last_stats.sprites);
+            line.append(" r ").append(render_queue.last_stats.radix_passes);
+            Text(line, camera_x + 10, camera_y + 240, TEXT_SMALL).draw();
+            ParticleStats &sparks = particles.last_stats;
+            line.clear();
+            line.append("p ").append(sparks.spawned).append("|").append(sparks.dropped);
+            line.append(" d ").append(sparks.drawn).append("|").append(sparks.culled);
+            Text(line, camera_x + 10, camera_y + 270, TEXT_SMALL).draw();
+            this->draw_wait_debug(camera_x, camera_y + 300);
+        }
+        /// What the frozen pause screen costs, next to the frame time
+        void draw_pause_debug(int camera_x, int camera_y, const PauseStats &stats) {
+            render_queue.set_layer(LAYER_HUD, BLEND_CUTOUT, NULL);
+            TextBuffer line;
+            line.append("us ").append((int)frame_pacer.frame_us);
+            line.append(" draw ").append((int)stats.draw_us);
+            line.append(" work ").append((int)stats.work_us);
+            Text(line, camera_x + 10, camera_y + 90, TEXT_SMALL).draw();
+            this->draw_wait_debug(camera_x, camera_y + 120);
         }
-        void draw_dashboard(int height) {
-            Sprite dashboard = Sprite(camera_x - 10, camera_y - 10, SCREEN_WIDTH + 50, height, WHITE_SPRITE);
-            dashboard.draw();
+        /// Time the last frame waited for the GPU and for the retrace
+        void draw_wait_debug(int x, int y) {
+            TextBuffer line;
+            line.append("gpu ").append((int)frame_pacer.last_stats.gpu_wait_us);
+            line.append(" vs ").append((int)frame_pacer.last_stats.vsync_wait_us);
+            Text(line, x + 10, y, TEXT_SMALL).draw();
         }
-        void draw_text(string text, int offset_x, int offset_y, int size) {
-            Text object(text, this->camera_x + offset_x, this->camera_y + offset_y, size);
-            object.draw();
+    private:
+        static void draw_dashboard(HudBuilder &builder, int height) {
+            builder.add(-10, -10, SCREEN_WIDTH + 50, height, SPRITE_WHITE);
         }
 };
 
-Player player;
+/* Everyone playing, one player for every controller plugged in */
+Player players[MAX_PLAYERS];
+Player &player = players[0];
+int player_count = 1;
+Gui gui;
 
 /* Holds ALL entities currently in the scene */
 vector<Entity*> entities { &player };
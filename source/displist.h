@@ -0,0 +1,58 @@
+/* A released display list and the last frame that may still call it */
+struct RetiredList {
+    void* list;
+    u32 frame;
+};
+
+/* Recycles 32-byte aligned display list buffers of one size, so lists
+ * that are rebuilt all the time don't go through the allocator. The GPU
+ * can be a frame behind, so a released list is only handed out again
+ * once every frame that might call it has been drawn. */
+class DisplayListPool {
+public:
+    u32 size;
+    vector<void*> free_lists;
+    vector<RetiredList> retired;
+    DisplayListPool(u32 size) {
+        // display lists have to be padded to 32 bytes
+        this->size = (size + 31) & ~31;
+    }
+    void* acquire() {
+        this->reclaim();
+        if(this->free_lists.empty()) {
+            return memalign(32, this->size);
+        }
+        void* list = this->free_lists.back();
+        this->free_lists.pop_back();
+        return list;
+    }
+    void release(void* list) {
+        if(list == NULL) return;
+        RetiredList retired = { list, frame_pacer.building() };
+        this->retired.push_back(retired);
+    }
+private:
+    void reclaim() {
+        for(size_t i = 0; i < this->retired.size();) {
+            if(this->retired[i].frame <= frame_pacer.completed) {
+                this->free_lists.push_back(this->retired[i].list);
+                this->retired[i] = this->retired.back();
+                this->retired.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+};
+
+/// Records everything draw() sends into list, returns the size
+/// of the recorded list, or 0 if it didn't fit.
+template<typename Draw>
+u32 record_display_list(void* list, u32 size, Draw draw) {
+    // the list is written through the write-gather pipe, so nothing
+    // stale may be left in the cache on top of it
+    DCInvalidateRange(list, size);
+    GX_BeginDispList(list, size);
+    draw();
+    return GX_EndDispList();
+}
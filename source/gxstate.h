@@ -0,0 +1,140 @@
+/* Counters for GX state changes, reset every frame */
+struct StateStats {
+    int issued;
+    int elided;
+    void reset() {
+        this->issued = 0;
+        this->elided = 0;
+    }
+};
+
+/* Tracks the GX state that has been set, so setting what is already
+ * loaded doesn't send anything to the GPU. Everything that changes this
+ * state has to go through here, or the cache goes stale. */
+class RenderState {
+public:
+    u8 vtx_desc[GX_VA_MAXATTR];
+    void* arrays[GX_VA_MAXATTR];
+    GXTexObj* textures[8];
+    int z_enable, z_func, z_update;
+    int z_comp_loc;
+    int alpha_func, alpha_ref;
+    int blend_mode, blend_src, blend_dst, blend_op;
+    int alpha_update;
+    int color_update;
+    bool vertex_arrays_dirty;
+    bool textures_dirty;
+    StateStats stats;
+    StateStats last_stats; // of the whole frame before, for readouts
+    RenderState() {
+        this->forget();
+        this->stats.reset();
+        this->last_stats.reset();
+    }
+    /// Makes the next call to every setter go through, needed after
+    /// GX_Init or anything else that changes state behind our back.
+    void forget() {
+        for(int i = 0; i < GX_VA_MAXATTR; i++) {
+            this->vtx_desc[i] = 0xff;
+            this->arrays[i] = NULL;
+        }
+        for(int i = 0; i < 8; i++) {
+            this->textures[i] = NULL;
+        }
+        this->z_enable = this->z_func = this->z_update = -1;
+        this->z_comp_loc = -1;
+        this->alpha_func = this->alpha_ref = -1;
+        this->blend_mode = this->blend_src = this->blend_dst = this->blend_op = -1;
+        this->alpha_update = -1;
+        this->color_update = -1;
+        this->vertex_arrays_dirty = true;
+        this->textures_dirty = true;
+    }
+    void begin_frame() {
+        this->last_stats = this->stats;
+        this->stats.reset();
+    }
+    void set_vtx_desc(u8 attribute, u8 type) {
+        if(!this->changed(this->vtx_desc[attribute] != type)) return;
+        GX_SetVtxDesc(attribute, type);
+        this->vtx_desc[attribute] = type;
+    }
+    void set_array(u32 attribute, void* data, u8 stride) {
+        if(!this->changed(this->arrays[attribute] != data)) return;
+        GX_SetArray(attribute, data, stride);
+        this->arrays[attribute] = data;
+    }
+    void load_texture(GXTexObj* texture, u8 map) {
+        if(!this->changed(this->textures[map] != texture)) return;
+        GX_LoadTexObj(texture, map);
+        this->textures[map] = texture;
+    }
+    void set_z_mode(u8 enable, u8 func, u8 update) {
+        if(!this->changed(this->z_enable != enable || this->z_func != func || this->z_update != update)) return;
+        GX_SetZMode(enable, func, update);
+        this->z_enable = enable;
+        this->z_func = func;
+        this->z_update = update;
+    }
+    /// Whether depth is tested before (GX_TRUE) or after texturing
+    void set_z_comp_loc(u8 before_tex) {
+        if(!this->changed(this->z_comp_loc != before_tex)) return;
+        GX_SetZCompLoc(before_tex);
+        this->z_comp_loc = before_tex;
+    }
+    /// Discards pixels whose alpha doesn't compare to ref with func
+    void set_alpha_compare(u8 func, u8 ref) {
+        if(!this->changed(this->alpha_func != func || this->alpha_ref != ref)) return;
+        GX_SetAlphaCompare(func, ref, GX_AOP_AND, GX_ALWAYS, 0);
+        this->alpha_func = func;
+        this->alpha_ref = ref;
+    }
+    void set_blend_mode(u8 mode, u8 src, u8 dst, u8 op) {
+        if(!this->changed(this->blend_mode != mode || this->blend_src != src ||
+                    this->blend_dst != dst || this->blend_op != op)) return;
+        GX_SetBlendMode(mode, src, dst, op);
+        this->blend_mode = mode;
+        this->blend_src = src;
+        this->blend_dst = dst;
+        this->blend_op = op;
+    }
+    void set_alpha_update(u8 enable) {
+        if(!this->changed(this->alpha_update != enable)) return;
+        GX_SetAlphaUpdate(enable);
+        this->alpha_update = enable;
+    }
+    void set_color_update(u8 enable) {
+        if(!this->changed(this->color_update != enable)) return;
+        GX_SetColorUpdate(enable);
+        this->color_update = enable;
+    }
+    /// Call after the CPU wrote to memory indexed vertices are read from
+    void mark_vertex_arrays_dirty() {
+        this->vertex_arrays_dirty = true;
+    }
+    /// Call after the CPU or an EFB copy wrote to texture memory
+    void mark_textures_dirty() {
+        this->textures_dirty = true;
+    }
+    void invalidate_vertex_cache() {
+        if(!this->changed(this->vertex_arrays_dirty)) return;
+        GX_InvVtxCache();
+        this->vertex_arrays_dirty = false;
+    }
+    void invalidate_textures() {
+        if(!this->changed(this->textures_dirty)) return;
+        GX_InvalidateTexAll();
+        this->textures_dirty = false;
+    }
+private:
+    bool changed(bool changed) {
+        if(changed) {
+            this->stats.issued++;
+        } else {
+            this->stats.elided++;
+        }
+        return changed;
+    }
+};
+
+RenderState render_state;
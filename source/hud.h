@@ -0,0 +1,87 @@
+#define HUD_MAX_QUADS 32
+#define HUD_LIST_SIZE (HUD_MAX_QUADS * 4 * 20 + 64)
+
+DisplayListPool hud_lists(HUD_LIST_SIZE);
+
+/* Collects the quads of one widget in screen coordinates while it is
+ * being rebuilt */
+class HudBuilder {
+public:
+    BatchQuad quads[HUD_MAX_QUADS];
+    int count;
+    GXTexObj* texture; // every quad of a widget has to share it
+    HudBuilder() {
+        this->count = 0;
+        this->texture = NULL;
+    }
+    void add(int x, int y, int width, int height, SpriteId id) {
+        SpriteBox box = trimmed_box(id, x, y, width, height);
+        this->add(box.x, box.y, box.width, box.height, sprite_uv(id), atlas_texture(id));
+    }
+    /// Adds a quad from a texture outside of the atlas
+    void add(int x, int y, int width, int height, const UV &uv, GXTexObj* texture) {
+        if(this->count == HUD_MAX_QUADS) return;
+        BatchQuad &quad = this->quads[this->count++];
+        quad.x0 = x;
+        quad.y0 = y;
+        quad.x1 = x + width - 1;
+        quad.y1 = y + height - 1;
+        quad.depth = DEPTH_HUD;
+        quad.matrix = GX_PNMTX0;
+        quad.texture_matrix = TEXMTX_STILL;
+        quad.uv = uv;
+        this->texture = texture;
+    }
+};
+
+/* One piece of the HUD, compiled into a display list in screen
+ * coordinates. The list is only recorded again when the value the
+ * widget shows changes, otherwise drawing it is a single call. */
+class HudWidget {
+public:
+    void* list;
+    u32 list_size;
+    BlendState blend;
+    GXTexObj* texture;
+    u32 value;
+    bool built;
+    int rebuilds;
+    HudWidget(BlendState blend) {
+        this->list = NULL;
+        this->list_size = 0;
+        this->blend = blend;
+        this->texture = NULL;
+        this->value = 0;
+        this->built = false;
+        this->rebuilds = 0;
+    }
+    ~HudWidget() {
+        hud_lists.release(this->list);
+    }
+    /// Rebuilds the widget with build() if value differs from the
+    /// value it was last built for
+    template<typename Build>
+    void update(u32 value, Build build) {
+        if(this->built && this->value == value) return;
+        HudBuilder builder;
+        build(builder);
+
+        hud_lists.release(this->list);
+        this->list = hud_lists.acquire();
+        this->list_size = record_display_list(this->list, hud_lists.size, [&]() {
+            emit_quads(builder.quads, builder.count, 0, 0);
+        });
+        this->texture = builder.texture;
+        this->value = value;
+        this->built = true;
+        this->rebuilds++;
+    }
+    /// Draws the widget, the position matrix has to translate screen
+    /// coordinates to the camera
+    void draw() {
+        if(this->list_size == 0) return;
+        sprite_batch.set_state(this->texture, this->blend);
+        sprite_batch.bind();
+        GX_CallDispList(this->list, this->list_size);
+    }
+};
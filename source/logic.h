@@ -3,6 +3,8 @@
 
 void game_loop();
 void draw_loop();
+void pause_work();
+void join_players(u32 connected);
 void handleProjectileCollisions();
 void removeExpiredProjectiles();
 void addEntity();
@@ -22,18 +24,25 @@ void setup() {
  
 /* All logic-events */
 void game_loop() {
-    PAD_ScanPads();
-    u16 pressed = PAD_ButtonsDown(0);
+    join_players(PAD_ScanPads());
+    u16 pressed = 0;
+    for(int n = 0; n < player_count; n++) {
+        pressed |= PAD_ButtonsDown(players[n].pad);
+    }
     if(BUTTON_B) {
         paused = !paused;        
+        if(!paused) frozen_frame.invalidate();
     }
 
     if(!paused) {
-        /* Refresh input from controller */
-        numParticles = projectiles.size();
-        area.update(player.getX(), player.getY());
-
-        numParticles = entities.size();
+        /* Keep the chunks around every player */
+        int x[MAX_PLAYERS];
+        int y[MAX_PLAYERS];
+        for(int n = 0; n < player_count; n++) {
+            x[n] = players[n].getX();
+            y[n] = players[n].getY();
+        }
+        area.update(x, y, player_count);
 
         /* All entities will act */
         for (Entity* entity : entities) {
@@ -48,27 +57,126 @@ void game_loop() {
         
         handleProjectileCollisions();
         removeExpiredProjectiles();
+
+        particles.update();
+        numParticles = particles.count;
     }
 }
 
 /* All draw-events */
 void draw_loop() {
-    Gui gui(camera.x, camera.y);
+    sprite_batch.begin_frame();
+    render_queue.begin_frame();
+    particles.begin_frame();
+    /* Nothing moves while paused, so the world isn't drawn again */
+    if(paused && frozen_frame.valid) {
+        u64 start = gettime();
+        split_screen.end();
+        frozen_frame.draw();
+        gui.draw(paused, entities.size(), player.getX() + WIDTH / 2, player.getY() + HEIGHT / 2);
+        if(SHOW_DEBUG_TEXT) {
+            gui.draw_pause_debug(0, 0, frozen_frame.stats);
+            render_queue.flush();
+            sprite_batch.flush();
+        }
+        frozen_frame.stats.draw_us = diff_usec(start, gettime());
+        return;
+    }
+    /* Water ripples by loading one texture matrix, whatever is on screen */
     if(!paused) {
-        area.draw();
+        tile_animation.advance();
+    }
+    /* Impostors are rendered in the top left of the EFB, so every
+     * viewport's have to be done before any of them is drawn */
+    for(int n = 0; n < split_screen.count; n++) {
+        Viewport &viewport = split_screen.viewports[n];
+        viewport.update_view();
+        area.capture(viewport.view);
+    }
+    /* Every viewport draws the same chunks and entities, only culling
+     * and submitting what its camera can see */
+    for(int n = 0; n < split_screen.count; n++) {
+        Viewport &viewport = split_screen.viewports[n];
+        View &view = viewport.view;
+        u64 start = gettime();
+
+        /* Layers behind the world call the same chunk display lists,
+         * tiles drawn one by one only exist for the world */
+        if(terrain_mode != TERRAIN_IMMEDIATE) {
+            for(int layer = PARALLAX_LAYERS - 1; layer > 0; layer--) {
+                viewport.begin_layer(parallax_layers[layer], area);
+                area.draw(viewport.layer_view);
+            }
+        }
+        viewport.begin();
+
+        /* Terrain is opaque, so it doesn't need blending at all */
+        render_queue.set_layer(LAYER_TERRAIN, BLEND_NONE, NULL);
+        area.draw(view);
+
+        /* Sprites only have fully transparent or opaque texels */
+        render_queue.set_layer(LAYER_SPRITES, BLEND_CUTOUT, NULL);
 
         /* Draw all entities currently in the "scene" */
         for (Entity* entity : entities) {
-            entity->draw();
+            entity->draw(view);
         }
         for (Projectile* p : projectiles) {
-            p->draw();
+            p->draw(view);
+        }
+        if(SHOW_DEBUG_TEXT && !paused) {
+            Player &followed = players[viewport.player];
+            gui.draw_debug(viewport.camera.pixel_x(), viewport.camera.pixel_y(), followed.getX(), followed.getY(),
+                    view.stats, viewport.draw_us);
+        }
+        /* Sort and submit everything queued for this viewport */
+        render_queue.flush();
+        sprite_batch.flush();
+        /* Particles are depth tested against the sprites, so order doesn't matter */
+        particles.draw(view);
+        viewport.draw_us = diff_usec(start, gettime());
+    }
+    split_screen.end();
+    /* The first paused frame keeps the world without the HUD for later */
+    if(paused) {
+        frozen_frame.capture();
+    }
+    /* The HUD goes on top, straight from its cached display lists. The
+     * minimap may have been charted by game_loop() this frame, after the
+     * main loop invalidated the texture cache. */
+    render_state.invalidate_textures();
+    gui.draw(paused, entities.size(), player.getX() + WIDTH / 2, player.getY() + HEIGHT / 2);
+}
+
+/* Uses what is left of a paused frame to generate chunks ahead of time */
+void pause_work() {
+    if(!paused) return;
+    u64 start = gettime();
+    u64 deadline = frame_pacer.frame_start + microsecs_to_ticks(PAUSE_WORK_US);
+    area.pregenerate(deadline);
+    frozen_frame.stats.work_us = diff_usec(start, gettime());
+}
+
+/* Gives every controller that was plugged in since a player and a
+ * viewport. Players joining late start next to the first one. */
+void join_players(u32 connected) {
+    for(int pad = 0; pad < MAX_PLAYERS; pad++) {
+        if(!(connected & (1 << pad)) || player_count == MAX_PLAYERS) continue;
+        bool playing = false;
+        for(int n = 0; n < player_count; n++) {
+            playing = playing || players[n].pad == pad;
         }
-        gui.draw_dashboard(80);
-        gui.draw_text(to_string(entities.size()), 10, 10, TEXT_MEDIUM);
-    } else {
-        gui.draw_dashboard(500);
-        gui.draw_text("PAUSED", 160, SCREEN_HEIGHT / 2 - 32, TEXT_BIG);
+        if(playing) continue;
+        Player &joined = players[player_count++];
+        joined.pad = pad;
+        joined.sprite.x = player.getX() + (player_count - 1) * WIDTH;
+        joined.sprite.y = player.getY();
+        entities.push_back(&joined);
+        split_screen.layout(player_count);
+        split_screen.viewports[player_count - 1].camera.x = split_screen.viewports[0].camera.x;
+        split_screen.viewports[player_count - 1].camera.y = split_screen.viewports[0].camera.y;
+        split_screen.viewports[player_count - 1].anchor_x = split_screen.viewports[0].anchor_x;
+        split_screen.viewports[player_count - 1].anchor_y = split_screen.viewports[0].anchor_y;
     }
 }
 
@@ -91,6 +199,7 @@ void console() {
     // PRINT STUFF HERE
     printf("\n\n"); // it starts printing way up, idk
     printf("Hello World!\n");
+    run_benchmarks();
     // ------------------------------------------------------------------
 
     while(true) {
@@ -130,6 +239,7 @@ void handleProjectileCollisions() {
                 
                 p->markedForDeletion = true;
                 e->handleProjectile(p);
+                particles.spawn_sparks(p->getX() + p->sprite.width / 2, p->getY() + p->sprite.height / 2, 24);
             } 
         }
     }
@@ -21,6 +21,7 @@ using namespace std;
 #include <ogcsys.h>
 
 #include <ogc/tpl.h>
+#include <ogc/lwp_watchdog.h>
 #include <asndlib.h>
 #include "library/oggplayer.h"
 // ------------------------------------------------------------------
@@ -32,8 +33,6 @@ using namespace std;
 
 // ------------------------------------------------------------------
 // INCLUDE DATA FILES HERE
-#include "textures_tpl.h"
-#include "textures.h"
 /* #include "town_ogg.h" */
 #include "fairy_path_ogg.h"
 // ------------------------------------------------------------------
@@ -41,26 +40,52 @@ using namespace std;
 // ------------------------------------------------------------------
 // CONSTANTS / IMPORTANT VARIABLES FOR BOILERPLATE
 #include "image_info.h"
+#include "sprite_table.h"
 #include "buttons.h"
-#include "names.h"
 
 #define DEFAULT_FIFO_SIZE	(256*1024)
+#define FRAME_BUFFERS 3
+#ifndef USE_CONSOLE // the host build's benchmark target turns it on
 #define USE_CONSOLE false
+#endif
+#define USE_COMPACT_VERTICES true
+#define USE_TOKEN_PACING true
+#define SHOW_DEBUG_TEXT false
+#define USE_PALETTE_TEXTURES true
+#define USE_PARALLAX_BACKDROP false
+#define PAUSE_WORK_US 10000 // of a paused frame that may go to background work
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
+#define MAX_PLAYERS 4
 
 static void *xfb = NULL;
-static void *frameBuffer[2] = { NULL, NULL};
+static void *frameBuffer[FRAME_BUFFERS] = { NULL, NULL, NULL };
 static GXRModeObj *rmode;
-GXTexObj texObj;
 // ------------------------------------------------------------------
 
 // ------------------------------------------------------------------
 // USER DEFINED HEADERS/LOGIC HERE
+#include "vertex.h"
+#include "camera.h"
+#include "gxstate.h"
+#include "pacing.h"
+#include "atlas.h"
+#include "animation.h"
+#include "text.h"
+#include "palette.h"
+#include "batch.h"
+#include "queue.h"
+#include "displist.h"
+#include "hud.h"
+#include "view.h"
+#include "particles.h"
+#include "terrain.h"
+#include "minimap.h"
+#include "pause.h"
 #include "classes.h"
+#include "viewport.h"
+#include "bench.h"
 
-// classes we want available in logic.h
-Camera camera;
 
 #include "logic.h"
 // ------------------------------------------------------------------
@@ -73,12 +98,9 @@ int main( int argc, char **argv ) {
     if(USE_CONSOLE) console();
     // ------------------------------------------------------------------
 
-    u32	fb; 	// initial framebuffer index
     u32 first_frame;
     f32 yscale;
     u32 xfbHeight;
-    Mtx44 perspective;
-    Mtx GXmodelView2D;
     void *gp_fifo = NULL;
 
     GXColor background = {0, 0, 0, 0xff};
@@ -87,21 +109,19 @@ int main( int argc, char **argv ) {
 
     rmode = VIDEO_GetPreferredMode(NULL);
 
-    fb = 0;
     first_frame = 1;
-    // allocate 2 framebuffers for double buffering
-    frameBuffer[0] = MEM_K0_TO_K1(SYS_AllocateFramebuffer(rmode));
-    frameBuffer[1] = MEM_K0_TO_K1(SYS_AllocateFramebuffer(rmode));
+    // allocate 3 framebuffers for triple buffering
+    for(int i = 0; i < FRAME_BUFFERS; i++) {
+        frameBuffer[i] = MEM_K0_TO_K1(SYS_AllocateFramebuffer(rmode));
+    }
 
     VIDEO_Configure(rmode);
-    VIDEO_SetNextFramebuffer(frameBuffer[fb]);
+    VIDEO_SetNextFramebuffer(frameBuffer[0]);
     VIDEO_SetBlack(FALSE);
     VIDEO_Flush();
     VIDEO_WaitVSync();
     if(rmode->viTVMode&VI_NON_INTERLACE) VIDEO_WaitVSync();
 
-    fb ^= 1;
-
     // setup the fifo and then init the flipper
     gp_fifo = memalign(32,DEFAULT_FIFO_SIZE);
     memset(gp_fifo,0,DEFAULT_FIFO_SIZE);
@@ -128,13 +148,13 @@ int main( int argc, char **argv ) {
 
 
     GX_SetCullMode(GX_CULL_NONE);
-    GX_CopyDisp(frameBuffer[fb],GX_TRUE);
+    GX_CopyDisp(frameBuffer[1],GX_TRUE);
     GX_SetDispCopyGamma(GX_GM_1_0);
 
-    // setup the vertex descriptor
-    // tells the flipper to expect direct data
-    GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XY, GX_F32, 0);
-    GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_TEX0, GX_TEX_ST, GX_F32, 0);
+    // setup the vertex formats
+    // tells the flipper how to read direct data
+    setup_vertex_formats(USE_COMPACT_VERTICES ? VERTEX_COMPACT : VERTEX_FLOAT);
+    setup_terrain_arrays();
 
 
     GX_SetNumChans(1);
@@ -143,15 +163,24 @@ int main( int argc, char **argv ) {
     GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
     GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, GX_IDENTITY);
 
-    GX_InvalidateTexAll();
+    setup_region_textures();
+    tile_animation.setup();
+    minimap.setup();
+    if(USE_PALETTE_TEXTURES) {
+        setup_palettes();
+    }
+    render_state.load_texture(&region_textures[REGION_SPRITES], GX_TEXMAP0);
+
+    // initial pixel state, the render state skips setting it again
+    // every frame unless something changed it
+    GX_ClearVtxDesc();
+    render_state.set_z_mode(GX_TRUE, GX_LEQUAL, GX_TRUE);
+    render_state.set_alpha_update(GX_TRUE);
+    render_state.set_color_update(GX_TRUE);
 
-    TPLFile spriteTPL;
-    TPL_OpenTPLFromMemory(&spriteTPL, (void *)textures_tpl,textures_tpl_size);
-    TPL_GetTexture(&spriteTPL,spritesheet,&texObj);
-    GX_LoadTexObj(&texObj, GX_TEXMAP0);
+    load_projection(SCREEN_WIDTH, SCREEN_HEIGHT);
 
-    guOrtho(perspective,0,SCREEN_HEIGHT,0,SCREEN_WIDTH,0,320);
-    GX_LoadProjectionMtx(perspective, GX_ORTHOGRAPHIC);
+    frame_pacer.setup(USE_TOKEN_PACING ? PACING_TOKEN : PACING_DRAW_DONE, frameBuffer);
 
     PAD_Init();
 
@@ -166,52 +195,35 @@ int main( int argc, char **argv ) {
 	setup();
 
     while(true) {
+        frame_pacer.begin_frame();
 
         // ------------------------------------------------------------------
         // Camera
-        guOrtho(perspective,camera.y,camera.y + SCREEN_HEIGHT, camera.x,camera.x + SCREEN_WIDTH, 0, 320);
-        GX_LoadProjectionMtx(perspective, GX_ORTHOGRAPHIC);
-        camera.follow_smooth(player.getX(), player.getY());
+        split_screen.follow(area);
         // ------------------------------------------------------------------
 
-        GX_InvVtxCache();
-        GX_InvalidateTexAll();
+        render_state.begin_frame();
+        render_state.invalidate_vertex_cache();
+        render_state.invalidate_textures();
 
-        GX_ClearVtxDesc();
-        GX_SetVtxDesc(GX_VA_POS, GX_DIRECT);
-        GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
-
-        guMtxIdentity(GXmodelView2D);
-        guMtxTransApply (GXmodelView2D, GXmodelView2D, 0.0F, 0.0F, -5.0F);
-        GX_LoadPosMtxImm(GXmodelView2D,GX_PNMTX0);
+        render_state.set_vtx_desc(GX_VA_POS, GX_DIRECT);
+        render_state.set_vtx_desc(GX_VA_TEX0, GX_DIRECT);
 
         // ------------------------------------------------------------------
         // GAME LOGIC AND DRAW LOOP
         game_loop();
         draw_loop();
+        pause_work();
         // ------------------------------------------------------------------
-                
-        int x_pos = player.getX() - (SCREEN_WIDTH - 64) / 2;
-        int y_pos = player.getY() - (SCREEN_HEIGHT - 64) / 2;
-        guOrtho(perspective,y_pos,SCREEN_HEIGHT + y_pos, x_pos,SCREEN_WIDTH + x_pos,0,320);
-        GX_LoadProjectionMtx(perspective, GX_ORTHOGRAPHIC);
-
-        GX_DrawDone();
-
-        GX_SetZMode(GX_TRUE, GX_LEQUAL, GX_TRUE);
-        GX_SetBlendMode(GX_BM_BLEND, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
-        GX_SetAlphaUpdate(GX_TRUE);
-        GX_SetColorUpdate(GX_TRUE);
-        GX_CopyDisp(frameBuffer[fb],GX_TRUE);
 
-        VIDEO_SetNextFramebuffer(frameBuffer[fb]);
+        render_state.set_z_mode(GX_TRUE, GX_LEQUAL, GX_TRUE);
+        render_state.set_alpha_update(GX_TRUE);
+        render_state.set_color_update(GX_TRUE);
         if(first_frame) {
             VIDEO_SetBlack(FALSE);
             first_frame = 0;
         }
-        VIDEO_Flush();
-        VIDEO_WaitVSync();
-        fb ^= 1;		// flip framebuffer
+        frame_pacer.end_frame();
     }
 
 	/* Stop music currently playing */
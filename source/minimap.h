@@ -0,0 +1,94 @@
+#define MINIMAP_SIZE 64   // texels a side, one texel per tile
+#define MINIMAP_VIEW 32   // tiles a side shown around the player
+#define MINIMAP_SCALE 3   // pixels a tile takes on screen
+#define MINIMAP_UNEXPLORED 0x0841
+
+static_assert((MINIMAP_SIZE & (MINIMAP_SIZE - 1)) == 0, "the minimap wraps, so it has to be a power of two");
+static_assert(MINIMAP_VIEW < MINIMAP_SIZE, "compact texture coordinates can't reach past 2.0");
+
+/* Every tile seen so far as one RGB565 texel, in a texture that wraps
+ * around in both directions. A tile lands at its world position modulo
+ * MINIMAP_SIZE, so terrain far enough away is overwritten by whatever
+ * was generated last, and the texture is never scrolled or redrawn.
+ *
+ * Chunks chart their tiles once when they are generated, which only
+ * touches the 4x4 texel blocks they fall in. One block is a cache line,
+ * so only those lines are flushed. */
+class Minimap {
+public:
+    u16 texels[MINIMAP_SIZE * MINIMAP_SIZE] __attribute__((aligned(32)));
+    u16 colors[SPRITE_COUNT];
+    GXTexObj texture;
+    Minimap() {
+        for(int n = 0; n < MINIMAP_SIZE * MINIMAP_SIZE; n++) {
+            this->texels[n] = MINIMAP_UNEXPLORED;
+        }
+        for(int id = 0; id < SPRITE_COUNT; id++) {
+            this->colors[id] = tile_color((SpriteId)id);
+        }
+        DCFlushRange(this->texels, sizeof(this->texels));
+    }
+    /// Sets up the texture object, has to run after GX_Init
+    void setup() {
+        GX_InitTexObj(&this->texture, this->texels, MINIMAP_SIZE, MINIMAP_SIZE,
+                GX_TF_RGB565, GX_REPEAT, GX_REPEAT, GX_FALSE);
+        GX_InitTexObjFilterMode(&this->texture, GX_NEAR, GX_NEAR);
+    }
+    /// Writes the tiles of a freshly generated chunk, tiles[i][j] being
+    /// the tile i to the right and j down from its top left corner
+    void chart(int tile_x, int tile_y, const SpriteId tiles[CHUNK_SIZE][CHUNK_SIZE]) {
+        for(int i = 0; i < CHUNK_SIZE; i++) {
+            for(int j = 0; j < CHUNK_SIZE; j++) {
+                this->texels[texel_index(tile_x + i, tile_y + j)] = this->colors[tiles[i][j]];
+            }
+        }
+        // a chunk covers at most this many blocks a side
+        const int blocks = (CHUNK_SIZE + 3) / 4 + 1;
+        for(int j = 0; j < blocks; j++) {
+            for(int i = 0; i < blocks; i++) {
+                int x = (tile_x & ~3) + i * 4;
+                int y = (tile_y & ~3) + j * 4;
+                if(x >= tile_x + CHUNK_SIZE || y >= tile_y + CHUNK_SIZE) continue;
+                DCFlushRange(&this->texels[texel_index(x, y)], 32);
+            }
+        }
+        render_state.mark_textures_dirty();
+    }
+    /// Adds the minimap to a widget as one quad, with the tile at tile_x
+    /// and tile_y in the middle. The texture wraps, so the window can
+    /// start anywhere.
+    void build(HudBuilder &builder, int x, int y, int tile_x, int tile_y) {
+        double start_s = ((tile_x - MINIMAP_VIEW / 2) & (MINIMAP_SIZE - 1)) / (double)MINIMAP_SIZE;
+        double start_t = ((tile_y - MINIMAP_VIEW / 2) & (MINIMAP_SIZE - 1)) / (double)MINIMAP_SIZE;
+        double span = MINIMAP_VIEW / (double)MINIMAP_SIZE;
+        int size = MINIMAP_VIEW * MINIMAP_SCALE;
+        builder.add(x, y, size, size, make_uv(start_s, start_t, start_s + span, start_t + span), &this->texture);
+    }
+private:
+    /// Where a tile is in the tiled texture, RGB565 is stored in 4x4 blocks
+    static int texel_index(int tile_x, int tile_y) {
+        int x = tile_x & (MINIMAP_SIZE - 1);
+        int y = tile_y & (MINIMAP_SIZE - 1);
+        int block = (y / 4) * (MINIMAP_SIZE / 4) + x / 4;
+        return block * 16 + (y % 4) * 4 + x % 4;
+    }
+    /// Averages a tile sprite down to the one texel it gets on the map
+    static u16 tile_color(SpriteId id) {
+        const SpriteRect &rect = sprite_rects[id];
+        if(rect.region != REGION_TILES) return MINIMAP_UNEXPLORED;
+        int width = region_widths[REGION_TILES];
+        u32 r = 0, g = 0, b = 0;
+        for(int y = rect.y; y < rect.y + rect.height; y++) {
+            for(int x = rect.x; x < rect.x + rect.width; x++) {
+                u16 texel = tiles_rgb565[((y / 4) * (width / 4) + x / 4) * 16 + (y % 4) * 4 + x % 4];
+                r += texel >> 11;
+                g += (texel >> 5) & 0x3f;
+                b += texel & 0x1f;
+            }
+        }
+        u32 count = rect.width * rect.height;
+        return (r / count) << 11 | (g / count) << 5 | b / count;
+    }
+};
+
+Minimap minimap;
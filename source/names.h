@@ -1,12 +0,0 @@
-#define ENEMY_SPRITE 10, 0
-#define FLAME_SPRITE 11, 0
-#define FLOOR_SPRITE 12, 0
-#define PLAYER_RIGHT_SPRITE 0, 3
-#define PLAYER_RIGHT_WALK_SPRITE 1, 3
-#define PLAYER_LEFT_SPRITE 2, 3
-#define PLAYER_LEFT_WALK_SPRITE 3, 3
-#define GRASS_SPRITE 4, 3
-#define WATER_SPRITE 5, 3
-#define STONE_SPRITE 6, 3
-#define DIRT_SPRITE 7, 3
-#define WHITE_SPRITE 8, 3
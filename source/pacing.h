@@ -0,0 +1,129 @@
+/* How the CPU waits for the GPU at the end of a frame */
+enum PacingMode {
+    PACING_DRAW_DONE, // block on GX_DrawDone, the CPU and GPU never overlap
+    PACING_TOKEN      // the GPU signals a draw sync token, the CPU moves on
+};
+
+/* Time the CPU spent waiting in the last frame */
+struct FrameStats {
+    u32 gpu_wait_us;   // for the GPU to finish or free up a framebuffer
+    u32 vsync_wait_us; // for the vertical retrace
+    void reset() {
+        this->gpu_wait_us = 0;
+        this->vsync_wait_us = 0;
+    }
+};
+
+/* Hands finished frames to the video interface. With PACING_TOKEN the
+ * CPU runs game_loop() for the next frame while the GPU still draws the
+ * last one, a third framebuffer makes sure it always has one to draw to.
+ *
+ * Frames are numbered from 1, frame n is drawn to buffers[n % FRAME_BUFFERS].
+ * Frame 0 is the buffer that is on screen at startup. */
+class FramePacer {
+public:
+    PacingMode mode;
+    void* buffers[FRAME_BUFFERS];
+    u32 issued;             // frames whose commands have been sent
+    volatile u32 completed; // frames the GPU has finished drawing
+    volatile u32 queued;    // latest finished frame handed to the video interface
+    volatile u32 shown;     // frame on screen since the last retrace
+    FrameStats stats;
+    FrameStats last_stats;  // of the whole frame before, for readouts
+    u64 frame_start;
+    u32 frame_us;           // time between the last two begin_frame() calls
+    FramePacer() {
+        this->mode = PACING_DRAW_DONE;
+        for(int i = 0; i < FRAME_BUFFERS; i++) {
+            this->buffers[i] = NULL;
+        }
+        this->issued = 0;
+        this->completed = 0;
+        this->queued = 0;
+        this->shown = 0;
+        this->stats.reset();
+        this->last_stats.reset();
+        this->frame_start = 0;
+        this->frame_us = 0;
+    }
+    void setup(PacingMode mode, void* buffers[FRAME_BUFFERS]);
+    /// The frame being built, anything it may still read from memory has
+    /// to stay untouched until completed reaches this
+    u32 building() {
+        return this->issued + 1;
+    }
+    /// Framebuffer the frame being built is copied to
+    void* current_buffer() {
+        return this->buffers[this->building() % FRAME_BUFFERS];
+    }
+    /// Waits until the framebuffer of the next frame isn't on screen
+    /// anymore. Only blocks when the GPU is more than a frame behind.
+    void begin_frame() {
+        u64 now = gettime();
+        if(this->frame_start != 0) this->frame_us = diff_usec(this->frame_start, now);
+        this->frame_start = now;
+        this->last_stats = this->stats;
+        this->stats.reset();
+        if(this->mode != PACING_TOKEN) return;
+        u32 frame = this->building();
+        if(frame < FRAME_BUFFERS) return;
+        u64 start = gettime();
+        while(this->shown < frame - (FRAME_BUFFERS - 1)) {
+            VIDEO_WaitVSync();
+        }
+        this->stats.gpu_wait_us += diff_usec(start, gettime());
+    }
+    /// Copies the EFB out to the frame's buffer and waits for the retrace
+    void end_frame() {
+        u32 frame = this->building();
+        void* buffer = this->current_buffer();
+        if(this->mode == PACING_TOKEN) {
+            GX_CopyDisp(buffer, GX_TRUE);
+            GX_SetDrawSync(frame % FRAME_BUFFERS);
+            GX_Flush();
+            this->issued = frame;
+        } else {
+            u64 start = gettime();
+            GX_DrawDone();
+            this->stats.gpu_wait_us += diff_usec(start, gettime());
+            GX_CopyDisp(buffer, GX_TRUE);
+            this->issued = frame;
+            this->completed = frame;
+            this->queued = frame;
+            VIDEO_SetNextFramebuffer(buffer);
+            VIDEO_Flush();
+        }
+        u64 start = gettime();
+        VIDEO_WaitVSync();
+        this->stats.vsync_wait_us += diff_usec(start, gettime());
+        if(this->mode != PACING_TOKEN) {
+            this->shown = frame;
+        }
+    }
+};
+
+FramePacer frame_pacer;
+
+/// Draw sync tokens arrive in order, so every token finishes the next frame
+static void frame_drawn(u16 token) {
+    frame_pacer.completed++;
+    VIDEO_SetNextFramebuffer(frame_pacer.buffers[token]);
+    VIDEO_Flush();
+    frame_pacer.queued = frame_pacer.completed;
+}
+
+/// Whatever was queued before the retrace is on screen after it
+static void frame_retraced(u32 count) {
+    frame_pacer.shown = frame_pacer.queued;
+}
+
+void FramePacer::setup(PacingMode mode, void* buffers[FRAME_BUFFERS]) {
+    this->mode = mode;
+    for(int i = 0; i < FRAME_BUFFERS; i++) {
+        this->buffers[i] = buffers[i];
+    }
+    if(mode == PACING_TOKEN) {
+        GX_SetDrawSyncCallback(frame_drawn);
+        VIDEO_SetPostRetraceCallback(frame_retraced);
+    }
+}
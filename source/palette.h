@@ -0,0 +1,91 @@
+/* Palettes the sprite region of the atlas can be drawn with. Each one is
+ * a TLUT over the same CI8 texels, so a recolored enemy costs 512 bytes
+ * of palette instead of more atlas space. */
+enum Palette {
+    PALETTE_BASE,
+    PALETTE_ELITE,     // second enemy tier
+    PALETTE_CHAMPION,  // third enemy tier
+    PALETTE_FLASH,     // everything opaque turns white, for hit flashes
+    PALETTE_COUNT
+};
+
+u16 palettes[PALETTE_COUNT][256] __attribute__((aligned(32)));
+GXTlutObj palette_tluts[PALETTE_COUNT];
+GXTexObj palette_textures[PALETTE_COUNT];
+
+/* An RGB5A3 palette entry with every channel widened to 8 bits */
+struct Color {
+    u8 r, g, b, a;
+};
+
+Color from_rgb5a3(u16 color) {
+    Color c;
+    if(color & 0x8000) {
+        c.r = ((color >> 10) & 0x1f) << 3;
+        c.g = ((color >> 5) & 0x1f) << 3;
+        c.b = (color & 0x1f) << 3;
+        c.a = 0xff;
+    } else {
+        c.a = ((color >> 12) & 0x7) << 5;
+        c.r = ((color >> 8) & 0xf) << 4;
+        c.g = ((color >> 4) & 0xf) << 4;
+        c.b = (color & 0xf) << 4;
+    }
+    return c;
+}
+
+u16 to_rgb5a3(Color c) {
+    if(c.a >= 0xe0) return 0x8000 | (c.r >> 3) << 10 | (c.g >> 3) << 5 | c.b >> 3;
+    return (c.a >> 5) << 12 | (c.r >> 4) << 8 | (c.g >> 4) << 4 | c.b >> 4;
+}
+
+/// Derives one palette from the base palette of the sprite texture
+Color recolor(Palette palette, Color c) {
+    Color out = c;
+    switch(palette) {
+        case PALETTE_BASE:
+            break;
+        case PALETTE_ELITE:
+            out.r = c.b;
+            out.b = c.r;
+            break;
+        case PALETTE_CHAMPION:
+            out.r = c.g;
+            out.g = c.r;
+            break;
+        case PALETTE_FLASH:
+            out.r = out.g = out.b = 0xff;
+            break;
+        default:
+            break;
+    }
+    return out;
+}
+
+/// Builds every palette and loads it into its own TLUT, then sets up a
+/// texture object for each that reads the shared CI8 texels through it
+void setup_palettes() {
+    for(int p = 0; p < PALETTE_COUNT; p++) {
+        for(int n = 0; n < 256; n++) {
+            Color c = from_rgb5a3(sprites_palette[n]);
+            palettes[p][n] = n < PALETTE_COLORS ? to_rgb5a3(recolor((Palette)p, c)) : 0;
+        }
+        DCFlushRange(palettes[p], sizeof(palettes[p]));
+        GX_InitTlutObj(&palette_tluts[p], palettes[p], GX_TL_RGB5A3, 256);
+        GX_LoadTlut(&palette_tluts[p], GX_TLUT0 + p);
+
+        GXTexObj &texture = palette_textures[p];
+        GX_InitTexObjCI(&texture, (void*)sprites_ci8,
+                region_widths[REGION_SPRITES], region_heights[REGION_SPRITES], GX_TF_CI8,
+                GX_CLAMP, GX_CLAMP, GX_FALSE, GX_TLUT0 + p);
+        GX_InitTexObjFilterMode(&texture, GX_NEAR, GX_NEAR);
+    }
+}
+
+/// Texture to draw sprites with in the given palette. The base palette
+/// is NULL, which draws from the RGB5A3 sprite texture like everything
+/// else, so it batches with it.
+GXTexObj* palette_texture(Palette palette) {
+    if(!USE_PALETTE_TEXTURES || palette == PALETTE_BASE) return NULL;
+    return &palette_textures[palette];
+}
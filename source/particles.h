@@ -0,0 +1,181 @@
+#define PARTICLE_CAPACITY 10240
+#define PARTICLE_GRAVITY 0.15F
+#define PARTICLE_DRAG 0.96F
+
+/* Counters for the particle pool, reset every frame */
+struct ParticleStats {
+    int spawned;
+    int dropped; // spawns that didn't fit in the pool
+    int drawn;
+    int culled;
+    void reset() {
+        this->spawned = 0;
+        this->dropped = 0;
+        this->drawn = 0;
+        this->culled = 0;
+    }
+};
+
+/* Every live particle in the game, stored as one array per field so
+ * update() is a handful of straight loops the compiler can unroll and
+ * vectorize. Live particles are always packed into [0, count), dead ones
+ * are swapped out with the last live one.
+ *
+ * All particles share the cutout blend state, and as long as their sprites
+ * are in the same region of the atlas, one texture, so draw() sends every
+ * visible one in a single GX_Begin. */
+class ParticlePool {
+public:
+    f32 x[PARTICLE_CAPACITY] __attribute__((aligned(32)));
+    f32 y[PARTICLE_CAPACITY] __attribute__((aligned(32)));
+    f32 vx[PARTICLE_CAPACITY] __attribute__((aligned(32)));
+    f32 vy[PARTICLE_CAPACITY] __attribute__((aligned(32)));
+    f32 gravity[PARTICLE_CAPACITY] __attribute__((aligned(32)));
+    s16 life[PARTICLE_CAPACITY] __attribute__((aligned(32)));
+    u8 size[PARTICLE_CAPACITY];
+    u8 sprite[PARTICLE_CAPACITY];
+    int count;
+    u32 random_state;
+    ParticleStats stats;
+    ParticleStats last_stats; // of the whole frame before, for readouts
+    ParticlePool() {
+        this->count = 0;
+        this->random_state = 0x2545F491;
+        this->stats.reset();
+        this->last_stats.reset();
+    }
+    void begin_frame() {
+        this->last_stats = this->stats;
+        this->stats.reset();
+    }
+    void clear() {
+        this->count = 0;
+    }
+    void spawn(f32 x, f32 y, f32 vx, f32 vy, f32 gravity, int life, int size, SpriteId id) {
+        if(this->count == PARTICLE_CAPACITY) {
+            this->stats.dropped++;
+            return;
+        }
+        int n = this->count++;
+        this->x[n] = x;
+        this->y[n] = y;
+        this->vx[n] = vx;
+        this->vy[n] = vy;
+        this->gravity[n] = gravity;
+        this->life[n] = life;
+        this->size[n] = size;
+        this->sprite[n] = id;
+        this->stats.spawned++;
+    }
+    /// Bursts count sparks out of x and y in every direction
+    void spawn_sparks(f32 x, f32 y, int count) {
+        for(int n = 0; n < count; n++) {
+            f32 vx = this->random_unit() * 4.0F;
+            f32 vy = this->random_unit() * 4.0F - 2.0F;
+            int life = 20 + (this->random() & 15);
+            this->spawn(x, y, vx, vy, PARTICLE_GRAVITY, life, 12, SPRITE_FLAME);
+        }
+    }
+    /// Leaves a short lived flame behind something moving at vx
+    void spawn_trail(f32 x, f32 y, f32 vx) {
+        f32 drift = this->random_unit() * 0.5F;
+        int life = 10 + (this->random() & 7);
+        this->spawn(x, y, -vx * 0.25F, drift - 0.5F, 0.0F, life, 24, SPRITE_FLAME);
+    }
+    /// Moves every particle one frame and removes the ones that died
+    void update() {
+        int count = this->count;
+        f32* __restrict__ x = this->x;
+        f32* __restrict__ y = this->y;
+        f32* __restrict__ vx = this->vx;
+        f32* __restrict__ vy = this->vy;
+        const f32* __restrict__ gravity = this->gravity;
+        s16* __restrict__ life = this->life;
+        for(int n = 0; n < count; n++) {
+            x[n] += vx[n];
+            y[n] += vy[n];
+            vx[n] *= PARTICLE_DRAG;
+            vy[n] = vy[n] * PARTICLE_DRAG + gravity[n];
+            life[n]--;
+        }
+        // dead particles are rare compared to live ones, so compacting
+        // them out is kept out of the loop above
+        for(int n = 0; n < this->count;) {
+            if(life[n] > 0) {
+                n++;
+                continue;
+            }
+            this->move(--this->count, n);
+        }
+    }
+    /// Sends every particle the view can see as one run of quads, with
+    /// positions relative to the sprite batch origin
+    void draw(View &view) {
+        if(this->count == 0) return;
+        static BatchQuad quads[PARTICLE_CAPACITY];
+        GXTexObj* texture = NULL;
+        int queued = 0;
+        int drawn = 0;
+        for(int n = 0; n < this->count; n++) {
+            int size = this->size[n];
+            int left = (int)this->x[n] - size / 2;
+            int top = (int)this->y[n] - size / 2;
+            if(!view.overlaps(left, top, size, size)) continue;
+            SpriteId id = (SpriteId)this->sprite[n];
+            // a sprite from another region breaks the run rather than
+            // being drawn with the wrong texture
+            if(atlas_texture(id) != texture) {
+                this->emit(quads, queued);
+                queued = 0;
+                texture = atlas_texture(id);
+                sprite_batch.set_state(texture, BLEND_CUTOUT);
+                sprite_batch.bind();
+            }
+            SpriteBox box = trimmed_box(id, left, top, size, size);
+            BatchQuad &quad = quads[queued++];
+            quad.x0 = box.x;
+            quad.y0 = box.y;
+            quad.x1 = box.x + box.width - 1;
+            quad.y1 = box.y + box.height - 1;
+            quad.depth = sprite_depth(top + size, sprite_batch.origin_y);
+            quad.matrix = GX_PNMTX0;
+            quad.texture_matrix = TEXMTX_STILL;
+            quad.uv = sprite_uv(id);
+            drawn++;
+        }
+        this->emit(quads, queued);
+        this->stats.drawn += drawn;
+        this->stats.culled += this->count - drawn;
+    }
+private:
+    void emit(const BatchQuad* quads, int count) {
+        if(count == 0) return;
+        emit_quads(quads, count, sprite_batch.origin_x, sprite_batch.origin_y);
+        sprite_batch.stats.bytes += count * 4 * vertex_size(vertex_mode);
+    }
+    void move(int from, int to) {
+        this->x[to] = this->x[from];
+        this->y[to] = this->y[from];
+        this->vx[to] = this->vx[from];
+        this->vy[to] = this->vy[from];
+        this->gravity[to] = this->gravity[from];
+        this->life[to] = this->life[from];
+        this->size[to] = this->size[from];
+        this->sprite[to] = this->sprite[from];
+    }
+    /// xorshift32, rand() is far too slow to call per particle
+    u32 random() {
+        u32 state = this->random_state;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        this->random_state = state;
+        return state;
+    }
+    /// Random number between -1 and 1
+    f32 random_unit() {
+        return (f32)(s32)this->random() * (1.0F / 2147483648.0F);
+    }
+};
+
+ParticlePool particles;
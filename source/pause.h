@@ -0,0 +1,66 @@
+/* Time the CPU spent on the last paused frame */
+struct PauseStats {
+    u32 draw_us; // submitting the frozen frame and the overlay
+    u32 work_us; // background work done in the rest of the frame
+    void reset() {
+        this->draw_us = 0;
+        this->work_us = 0;
+    }
+};
+
+/* The last frame drawn before the game paused, copied out of the EFB
+ * once. While paused the world isn't drawn at all, every frame is this
+ * texture as one quad with the pause overlay on top. */
+class FrozenFrame {
+public:
+    void* texels;
+    GXTexObj texture;
+    bool valid;
+    PauseStats stats;
+    FrozenFrame() {
+        this->texels = NULL;
+        this->valid = false;
+        this->stats.reset();
+    }
+    /// Copies what has been drawn so far into the texture, without
+    /// clearing it so the frame can still be finished and shown
+    void capture() {
+        u16 width = rmode->fbWidth;
+        u16 height = rmode->efbHeight;
+        if(this->texels == NULL) {
+            // allocated the first time the game pauses and kept after
+            this->texels = memalign(32, GX_GetTexBufferSize(width, height, GX_TF_RGB565, GX_FALSE, 0));
+            GX_InitTexObj(&this->texture, this->texels, width, height, GX_TF_RGB565, GX_CLAMP, GX_CLAMP, GX_FALSE);
+            GX_InitTexObjFilterMode(&this->texture, GX_NEAR, GX_NEAR);
+        }
+        GX_SetTexCopySrc(0, 0, width, height);
+        GX_SetTexCopyDst(width, height, GX_TF_RGB565, GX_FALSE);
+        GX_CopyTex(this->texels, GX_FALSE);
+        GX_PixModeSync();
+        render_state.mark_textures_dirty();
+        this->valid = true;
+    }
+    /// Call when the game goes on, the next pause captures a new frame
+    void invalidate() {
+        this->valid = false;
+    }
+    /// Draws the frozen frame over the whole screen, behind the HUD.
+    /// The position matrix has to translate screen coordinates to the camera.
+    void draw() {
+        sprite_batch.set_state(&this->texture, BLEND_NONE);
+        sprite_batch.bind();
+        BatchQuad quad;
+        quad.x0 = 0;
+        quad.y0 = 0;
+        quad.x1 = SCREEN_WIDTH;
+        quad.y1 = SCREEN_HEIGHT;
+        quad.depth = DEPTH_TERRAIN;
+        quad.matrix = GX_PNMTX0;
+        quad.texture_matrix = TEXMTX_STILL;
+        quad.uv = make_uv(0.0, 0.0, 1.0, 1.0);
+        emit_quads(&quad, 1, 0, 0);
+        sprite_batch.stats.bytes += 4 * vertex_size(vertex_mode);
+    }
+};
+
+FrozenFrame frozen_frame;
@@ -0,0 +1,181 @@
+#define RENDER_QUEUE_CAPACITY 8192
+#define RENDER_QUEUE_TEXTURES 16
+
+/* Layers are drawn back to front, each one sorted its own way */
+enum RenderLayer {
+    LAYER_TERRAIN, // grouped by state
+    LAYER_SPRITES, // grouped by state, the z-buffer sorts out which sprite is in front
+    LAYER_HUD      // in the order they were pushed
+};
+
+/* The compact sprite a queue entry draws */
+struct QueuedSprite {
+    s32 x, y;
+    s16 width, height;
+    s16 depth;
+    u16 sprite;
+    f32 rotation; // radians around the center
+    f32 scale;
+};
+
+/* A sort key and the sprite it belongs to. Keys are laid out as
+ * layer (8 bits) | order (32 bits) | blend (8 bits) | texture (16 bits) */
+struct SortEntry {
+    u64 key;
+    u32 index;
+};
+
+/* Counters for the last flushed frame */
+struct QueueStats {
+    int sprites;
+    int radix_passes;
+    void reset() {
+        this->sprites = 0;
+        this->radix_passes = 0;
+    }
+};
+
+/* Subsystems push sprites with a sort key during draw_loop(). At the end
+ * of the frame the keys are radix sorted once, and the sprites are handed
+ * to the sprite batch in that order, so state only changes between runs. */
+class RenderQueue {
+public:
+    QueuedSprite sprites[RENDER_QUEUE_CAPACITY];
+    SortEntry entries[RENDER_QUEUE_CAPACITY];
+    SortEntry scratch[RENDER_QUEUE_CAPACITY];
+    GXTexObj* textures[RENDER_QUEUE_TEXTURES]; // of the sprites queued, emptied by every flush
+    int texture_count;
+    int count;
+    RenderLayer layer;
+    BlendState blend;
+    GXTexObj* texture; // NULL draws every sprite from the texture of its region
+    u64 state_key;
+    u32 order;
+    QueueStats stats;
+    QueueStats last_stats; // of the whole frame before, for readouts
+    RenderQueue() {
+        this->texture_count = 0;
+        this->count = 0;
+        this->layer = LAYER_TERRAIN;
+        this->blend = BLEND_NONE;
+        this->texture = NULL;
+        this->state_key = 0;
+        this->order = 0;
+        this->stats.reset();
+        this->last_stats.reset();
+    }
+    void begin_frame() {
+        this->last_stats = this->stats;
+        this->stats.reset();
+        this->order = 0;
+    }
+    /// Sets the layer, blend state and texture of the sprites pushed after
+    void set_layer(RenderLayer layer, BlendState blend, GXTexObj* texture) {
+        this->layer = layer;
+        this->blend = blend;
+        this->texture = texture;
+        this->state_key = (u64)layer << 56 | (u64)blend << 16;
+    }
+    /// Swaps only the texture of the sprites pushed after
+    void set_texture(GXTexObj* texture) {
+        this->texture = texture;
+    }
+    void push(int x, int y, int width, int height, SpriteId id) {
+        this->push(x, y, width, height, id, 0.0F, 1.0F);
+    }
+    void push(int x, int y, int width, int height, SpriteId id, f32 rotation, f32 scale) {
+        if(this->count == RENDER_QUEUE_CAPACITY) this->flush();
+        // may flush too, so it comes before anything is written
+        u32 texture = this->texture_id(this->texture != NULL ? this->texture : atlas_texture(id));
+        u32 order = 0;
+        QueuedSprite &sprite = this->sprites[this->count];
+        switch(this->layer) {
+            case LAYER_TERRAIN:
+                sprite.depth = DEPTH_TERRAIN;
+                break;
+            case LAYER_SPRITES:
+                sprite.depth = sprite_depth(y + height, sprite_batch.origin_y);
+                break;
+            case LAYER_HUD:
+                sprite.depth = DEPTH_HUD;
+                order = this->order++;
+                break;
+        }
+        sprite.x = x;
+        sprite.y = y;
+        sprite.width = width;
+        sprite.height = height;
+        sprite.sprite = id;
+        sprite.rotation = rotation;
+        sprite.scale = scale;
+        SortEntry &entry = this->entries[this->count];
+        entry.key = this->state_key | (u64)order << 24 | texture;
+        entry.index = this->count;
+        this->count++;
+    }
+    /// Sorts everything pushed so far and hands it to the sprite batch
+    void flush() {
+        if(this->count == 0) return;
+        SortEntry* sorted = this->sort();
+        for(int n = 0; n < this->count; n++) {
+            u64 key = sorted[n].key;
+            QueuedSprite &sprite = this->sprites[sorted[n].index];
+            sprite_batch.set_state(this->textures[key & 0xffff], (BlendState)((key >> 16) & 0xff));
+            SpriteId id = (SpriteId)sprite.sprite;
+            SpriteBox box = trimmed_box(id, sprite.x, sprite.y, sprite.width, sprite.height);
+            if(sprite.rotation != 0.0F || sprite.scale != 1.0F) {
+                int center_x = sprite.x + sprite.width / 2;
+                int center_y = sprite.y + sprite.height / 2;
+                sprite_batch.add_transformed(center_x, center_y, box.x - center_x, box.y - center_y,
+                        box.width, box.height, sprite.depth, sprite_uv(id), sprite.rotation, sprite.scale);
+            } else {
+                sprite_batch.add(box.x, box.y, box.x + box.width - 1, box.y + box.height - 1,
+                        sprite.depth, sprite_uv(id), tile_texture_matrix(id));
+            }
+        }
+        this->stats.sprites += this->count;
+        this->count = 0;
+        // nothing queued refers to the table anymore
+        this->texture_count = 0;
+    }
+private:
+    /// Index of texture in the table, registering it if it's new. A full
+    /// table is emptied by drawing everything queued so far.
+    u32 texture_id(GXTexObj* texture) {
+        for(int i = 0; i < this->texture_count; i++) {
+            if(this->textures[i] == texture) return i;
+        }
+        if(this->texture_count == RENDER_QUEUE_TEXTURES) this->flush();
+        this->textures[this->texture_count] = texture;
+        return this->texture_count++;
+    }
+    /// Stable LSD radix sort on the key, one byte at a time. Bytes that
+    /// are the same for every entry are skipped, which most of them are.
+    SortEntry* sort() {
+        SortEntry* from = this->entries;
+        SortEntry* to = this->scratch;
+        for(int shift = 0; shift < 64; shift += 8) {
+            int counts[256] = {};
+            for(int n = 0; n < this->count; n++) {
+                counts[(from[n].key >> shift) & 0xff]++;
+            }
+            if(counts[(from[0].key >> shift) & 0xff] == this->count) continue;
+            int offset = 0;
+            for(int b = 0; b < 256; b++) {
+                int c = counts[b];
+                counts[b] = offset;
+                offset += c;
+            }
+            for(int n = 0; n < this->count; n++) {
+                to[counts[(from[n].key >> shift) & 0xff]++] = from[n];
+            }
+            SortEntry* swap = from;
+            from = to;
+            to = swap;
+            this->stats.radix_passes++;
+        }
+        return from;
+    }
+};
+
+RenderQueue render_queue;
@@ -0,0 +1,194 @@
+/* How terrain chunks are sent to the GPU */
+enum TerrainMode {
+    TERRAIN_IMMEDIATE,    // every tile goes through the sprite batch each frame
+    TERRAIN_DISPLAY_LIST, // each chunk is baked into a display list once
+    TERRAIN_INDEXED,      // like TERRAIN_DISPLAY_LIST, but tiles are indices into shared arrays
+    TERRAIN_IMPOSTOR      // each chunk is rendered into a texture once and drawn as one quad
+};
+
+TerrainMode terrain_mode = TERRAIN_INDEXED;
+
+#define CHUNK_SIZE 6
+#define CHUNK_SPACING (64 * CHUNK_SIZE)
+// where noise of this frequency is above CHUNK_GAP_NOISE, a tile is
+// left out of the world so the backdrop shows, when there is one
+#define CHUNK_GAP_FREQUENCY 0.3F
+#define CHUNK_GAP_NOISE 0.6F
+// every 2x2 tiles of a chunk are their own run in its display list, so
+// views that only see some of the chunk can call just the parts they see
+#define CHUNK_PART_SIZE 2
+#define CHUNK_PARTS_ACROSS (CHUNK_SIZE / CHUNK_PART_SIZE)
+#define CHUNK_PARTS (CHUNK_PARTS_ACROSS * CHUNK_PARTS_ACROSS)
+#define CHUNK_PART_SPACING (64 * CHUNK_PART_SIZE)
+// the largest vertex is a float position and texcoord with a texture
+// matrix index, every part is padded to 32 bytes
+#define CHUNK_LIST_SIZE (CHUNK_SIZE * CHUNK_SIZE * 4 * (5 * sizeof(f32) + 1) + CHUNK_PARTS * 64)
+
+/* Display lists of chunks that have been evicted, reused by new chunks */
+DisplayListPool chunk_lists(CHUNK_LIST_SIZE);
+
+#define LATTICE_SIZE (CHUNK_SIZE + 1)
+
+/* Every tile corner of a chunk, relative to the chunk. Since chunks are
+ * drawn with their own translation, one lattice is shared by all of them */
+static s16 terrain_lattice[LATTICE_SIZE * LATTICE_SIZE * 2] ATTRIBUTE_ALIGN(32);
+/* The four corners of every sprite as compact texture coordinates, only
+ * filled in for sprites in the tile texture */
+static u16 atlas_corners[SPRITE_COUNT * 4 * 2] ATTRIBUTE_ALIGN(32);
+
+static_assert(LATTICE_SIZE * LATTICE_SIZE <= 256, "lattice has to be addressable by GX_INDEX8");
+static_assert(SPRITE_COUNT * 4 <= 256, "atlas corners have to be addressable by GX_INDEX8");
+
+/// Fills the arrays indexed terrain is drawn from, has to run once after GX_Init
+void setup_terrain_arrays() {
+    for(int j = 0; j < LATTICE_SIZE; j++) {
+        for(int i = 0; i < LATTICE_SIZE; i++) {
+            int index = (j * LATTICE_SIZE + i) * 2;
+            terrain_lattice[index] = i * WIDTH;
+            terrain_lattice[index + 1] = j * HEIGHT;
+        }
+    }
+    for(int id = 0; id < SPRITE_COUNT; id++) {
+        if(sprite_region((SpriteId)id) != REGION_TILES) continue;
+        const UV &uv = sprite_uv((SpriteId)id);
+        u16 corners[8] = { uv.fs0, uv.ft0, uv.fs1, uv.ft0, uv.fs1, uv.ft1, uv.fs0, uv.ft1 };
+        memcpy(&atlas_corners[id * 8], corners, sizeof(corners));
+    }
+    DCFlushRange(terrain_lattice, sizeof(terrain_lattice));
+    DCFlushRange(atlas_corners, sizeof(atlas_corners));
+    render_state.mark_vertex_arrays_dirty();
+}
+
+/// Whether chunk display lists are recorded as indices
+bool terrain_indexed() {
+    return terrain_mode == TERRAIN_INDEXED || terrain_mode == TERRAIN_IMPOSTOR;
+}
+
+/// Switches the vertex descriptor over to the one chunk display lists are
+/// recorded and called with: indices in the indexed modes, and a texture
+/// matrix for every vertex so animated tiles move
+void begin_terrain() {
+    if(terrain_indexed()) {
+        render_state.set_vtx_desc(GX_VA_POS, GX_INDEX8);
+        render_state.set_vtx_desc(GX_VA_TEX0, GX_INDEX8);
+        render_state.set_array(GX_VA_POS, terrain_lattice, 2 * sizeof(s16));
+        render_state.set_array(GX_VA_TEX0, atlas_corners, 2 * sizeof(u16));
+    }
+    render_state.set_vtx_desc(GX_VA_TEX0MTXIDX, GX_DIRECT);
+}
+
+/// Switches the vertex descriptor back to direct data for sprites
+void end_terrain() {
+    render_state.set_vtx_desc(GX_VA_POS, GX_DIRECT);
+    render_state.set_vtx_desc(GX_VA_TEX0, GX_DIRECT);
+    render_state.set_vtx_desc(GX_VA_TEX0MTXIDX, GX_NONE);
+}
+
+/// Sends the four corners of the tile at tile_i and tile_j in a chunk,
+/// textured with the given sprite, which has to be a terrain sprite
+void emit_indexed_tile(int tile_i, int tile_j, SpriteId id) {
+    u8 position = tile_j * LATTICE_SIZE + tile_i;
+    u8 texcoord = id * 4;
+    u8 texture_matrix = tile_texture_matrix(id);
+    GX_MatrixIndex1x8(texture_matrix);
+    GX_Position1x8(position);
+    GX_TexCoord1x8(texcoord);
+    GX_MatrixIndex1x8(texture_matrix);
+    GX_Position1x8(position + 1);
+    GX_TexCoord1x8(texcoord + 1);
+    GX_MatrixIndex1x8(texture_matrix);
+    GX_Position1x8(position + LATTICE_SIZE + 1);
+    GX_TexCoord1x8(texcoord + 2);
+    GX_MatrixIndex1x8(texture_matrix);
+    GX_Position1x8(position + LATTICE_SIZE);
+    GX_TexCoord1x8(texcoord + 3);
+}
+
+/* One chunk sized texture a chunk was rendered into */
+struct Impostor {
+    void* texels;
+    GXTexObj texture;
+    bool used;
+    u32 released_frame; // last frame that may still draw it
+};
+
+/* Enough impostors for the 3x3 ring of chunks around one player, plus
+ * a row of them still being drawn by the GPU after they were evicted.
+ * With more players, chunks that don't get one draw their display list. */
+#define IMPOSTOR_SLOTS 12
+
+/* A fixed set of impostor textures, allocated the first time they're
+ * needed so the other terrain modes don't pay for their memory */
+class ImpostorPool {
+public:
+    Impostor slots[IMPOSTOR_SLOTS];
+    ImpostorPool() {
+        for(int i = 0; i < IMPOSTOR_SLOTS; i++) {
+            this->slots[i].texels = NULL;
+            this->slots[i].used = false;
+            this->slots[i].released_frame = 0;
+        }
+    }
+    /// Returns a free slot, or -1 if all are taken
+    int acquire() {
+        for(int i = 0; i < IMPOSTOR_SLOTS; i++) {
+            Impostor &impostor = this->slots[i];
+            if(impostor.used || impostor.released_frame > frame_pacer.completed) continue;
+            if(impostor.texels == NULL) {
+                u32 size = GX_GetTexBufferSize(CHUNK_SPACING, CHUNK_SPACING, GX_TF_RGB565, GX_FALSE, 0);
+                impostor.texels = memalign(32, size);
+                // only the GPU writes to it from here on
+                DCInvalidateRange(impostor.texels, size);
+                GX_InitTexObj(&impostor.texture, impostor.texels, CHUNK_SPACING, CHUNK_SPACING,
+                        GX_TF_RGB565, GX_CLAMP, GX_CLAMP, GX_FALSE);
+                GX_InitTexObjFilterMode(&impostor.texture, GX_NEAR, GX_NEAR);
+            }
+            impostor.used = true;
+            return i;
+        }
+        return -1;
+    }
+    void release(int slot) {
+        if(slot < 0) return;
+        this->slots[slot].used = false;
+        this->slots[slot].released_frame = frame_pacer.building();
+    }
+    /// Renders an indexed chunk display list at the top left of the EFB
+    /// and copies it into the slot's texture. Has to happen before
+    /// anything else is drawn in the frame, since it clears what it covers.
+    void capture(int slot, void* list, u32 size) {
+        CameraTransform camera = camera_transform;
+        f32 width = projection_width;
+        f32 height = projection_height;
+        load_projection(SCREEN_WIDTH, SCREEN_HEIGHT);
+        load_camera(0, 0, 0);
+        load_translation(0, 0, DEPTH_TERRAIN);
+        begin_terrain();
+        GX_CallDispList(list, size);
+        end_terrain();
+        load_projection(width, height);
+        camera_transform = camera;
+
+        GX_SetTexCopySrc(0, 0, CHUNK_SPACING, CHUNK_SPACING);
+        GX_SetTexCopyDst(CHUNK_SPACING, CHUNK_SPACING, GX_TF_RGB565, GX_FALSE);
+        GX_CopyTex(this->slots[slot].texels, GX_TRUE);
+        GX_PixModeSync();
+        render_state.mark_textures_dirty();
+    }
+    /// Draws the slot's texture as one chunk sized quad at the current translation
+    void draw(int slot) {
+        render_state.load_texture(&this->slots[slot].texture, GX_TEXMAP0);
+        BatchQuad quad;
+        quad.x0 = 0;
+        quad.y0 = 0;
+        quad.x1 = CHUNK_SPACING;
+        quad.y1 = CHUNK_SPACING;
+        quad.depth = 0;
+        quad.matrix = GX_PNMTX0;
+        quad.texture_matrix = TEXMTX_STILL;
+        quad.uv = make_uv(0.0, 0.0, 1.0, 1.0);
+        emit_quads(&quad, 1, 0, 0);
+    }
+};
+
+ImpostorPool impostors;
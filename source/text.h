@@ -0,0 +1,137 @@
+#define TEXT_CAPACITY 64
+
+/* Which sprite a character is drawn with */
+struct Glyph {
+    u8 sprite;
+    bool visible; // blank glyphs only move the cursor
+};
+
+struct GlyphTable {
+    Glyph glyphs[128];
+};
+
+constexpr Glyph make_glyph(int sprite) {
+    return Glyph { (u8)sprite, true };
+}
+
+static_assert(SPRITE_GLYPH_9 - SPRITE_GLYPH_0 == 9, "digits have to be in order in the manifest");
+static_assert(SPRITE_GLYPH_Z - SPRITE_GLYPH_A == 25, "letters have to be in order in the manifest");
+static_assert(SPRITE_COUNT <= 256, "glyphs store sprites as a byte");
+static_assert(sprite_rects[SPRITE_GLYPH_MINUS].region == sprite_rects[SPRITE_GLYPH_A].region
+        && sprite_rects[SPRITE_GLYPH_PERIOD].region == sprite_rects[SPRITE_GLYPH_A].region
+        && sprite_rects[SPRITE_GLYPH_COLON].region == sprite_rects[SPRITE_GLYPH_A].region,
+        "text is drawn from one texture, punctuation has to be packed with the letters");
+
+/// Lowercase letters share the uppercase glyphs. Of the punctuation only
+/// what readouts need has glyphs of its own, the few characters that have
+/// a lookalike use it and everything else is a blank space.
+constexpr GlyphTable make_glyph_table() {
+    GlyphTable table = {};
+    for(int c = 0; c < 128; c++) {
+        table.glyphs[c] = Glyph { 0, false };
+    }
+    for(int c = '0'; c <= '9'; c++) {
+        table.glyphs[c] = make_glyph(SPRITE_GLYPH_0 + c - '0');
+    }
+    for(int c = 'A'; c <= 'Z'; c++) {
+        table.glyphs[c] = make_glyph(SPRITE_GLYPH_A + c - 'A');
+        table.glyphs[c - 'A' + 'a'] = table.glyphs[c];
+    }
+    table.glyphs['-'] = make_glyph(SPRITE_GLYPH_MINUS);
+    table.glyphs['.'] = make_glyph(SPRITE_GLYPH_PERIOD);
+    table.glyphs[':'] = make_glyph(SPRITE_GLYPH_COLON);
+    table.glyphs['!'] = table.glyphs['I'];
+    table.glyphs['|'] = table.glyphs['I'];
+    table.glyphs['('] = table.glyphs['C'];
+    return table;
+}
+
+constexpr GlyphTable glyph_table = make_glyph_table();
+
+constexpr const Glyph& glyph(char c) {
+    return glyph_table.glyphs[(u8)c & 127];
+}
+
+static_assert(glyph('0').sprite == SPRITE_GLYPH_0, "digits map to their glyphs");
+static_assert(glyph('M').sprite == SPRITE_GLYPH_M, "letters map to their glyphs");
+static_assert(glyph('n').sprite == SPRITE_GLYPH_N, "lowercase shares uppercase glyphs");
+static_assert(glyph('-').visible, "negative numbers keep their sign");
+static_assert(!glyph(' ').visible, "spaces aren't drawn");
+
+/* Fixed capacity text, formatted without going through the heap, so
+ * readouts can be rebuilt every frame. Anything past TEXT_CAPACITY is
+ * cut off. */
+class TextBuffer {
+public:
+    char chars[TEXT_CAPACITY + 1];
+    int length;
+    TextBuffer() {
+        this->clear();
+    }
+    TextBuffer(const char* text) {
+        this->clear();
+        this->append(text);
+    }
+    void clear() {
+        this->length = 0;
+        this->chars[0] = '\0';
+    }
+    TextBuffer& append(char c) {
+        if(this->length == TEXT_CAPACITY) return *this;
+        this->chars[this->length++] = c;
+        this->chars[this->length] = '\0';
+        return *this;
+    }
+    TextBuffer& append(const char* text) {
+        while(*text != '\0') {
+            this->append(*text++);
+        }
+        return *this;
+    }
+    TextBuffer& append(int value) {
+        // work in negative numbers, so INT_MIN doesn't overflow
+        if(value >= 0) value = -value;
+        else this->append('-');
+        char digits[10];
+        int count = 0;
+        do {
+            digits[count++] = '0' - value % 10;
+            value /= 10;
+        } while(value != 0);
+        while(count > 0) {
+            this->append(digits[--count]);
+        }
+        return *this;
+    }
+    /// Appends value rounded to the given number of decimals
+    TextBuffer& append(f32 value, int decimals) {
+        int scale = 1;
+        for(int i = 0; i < decimals; i++) {
+            scale *= 10;
+        }
+        int scaled = (int)roundf(value * scale);
+        if(scaled < 0) {
+            this->append('-');
+            scaled = -scaled;
+        }
+        this->append(scaled / scale);
+        if(decimals == 0) return *this;
+        this->append('.');
+        for(int place = scale / 10; place > 0; place /= 10) {
+            this->append((char)('0' + scaled / place % 10));
+        }
+        return *this;
+    }
+};
+
+/// Calls emit(x, y, size, size, sprite) for every visible glyph of text,
+/// starting at x and y
+template<typename Emit>
+void layout_text(const char* text, int x, int y, int size, Emit emit) {
+    int spacing = size * 4 / 5;
+    for(int index = 0; text[index] != '\0'; index++) {
+        const Glyph &g = glyph(text[index]);
+        if(!g.visible) continue;
+        emit(x + index * spacing, y, size, size, (SpriteId)g.sprite);
+    }
+}
@@ -0,0 +1,60 @@
+/* Vertex formats quads can be sent to the GPU in */
+enum VertexMode {
+    VERTEX_FLOAT,   // f32 positions and texture coordinates, 20 bytes per vertex
+    VERTEX_COMPACT  // s16 positions and u16 texture coordinates, 10 bytes per vertex
+};
+
+#define VTXFMT_FLOAT GX_VTXFMT0
+#define VTXFMT_COMPACT GX_VTXFMT1
+/* Compact vertices read from arrays through 8-bit indices, used by terrain */
+#define VTXFMT_INDEXED GX_VTXFMT2
+
+/* Fraction bits of compact texture coordinates, 1.0 is 1 << TEXCOORD_FRAC */
+#define TEXCOORD_FRAC 15
+
+/* Distances from the camera, the z-buffer keeps whatever is closest.
+ * Sprites sit between DEPTH_SPRITES and DEPTH_HUD depending on how far
+ * down the screen their feet are, so lower sprites cover higher ones. */
+#define DEPTH_FAR 32000
+#define DEPTH_TERRAIN 30000
+#define DEPTH_SPRITES 20000
+#define DEPTH_HUD 100
+
+VertexMode vertex_mode = VERTEX_FLOAT;
+
+/// Configures both vertex formats and picks the one quads are sent in.
+/// Either format stays usable afterwards, only the default changes.
+void setup_vertex_formats(VertexMode mode) {
+    GX_SetVtxAttrFmt(VTXFMT_FLOAT, GX_VA_POS, GX_POS_XYZ, GX_F32, 0);
+    GX_SetVtxAttrFmt(VTXFMT_FLOAT, GX_VA_TEX0, GX_TEX_ST, GX_F32, 0);
+
+    GX_SetVtxAttrFmt(VTXFMT_COMPACT, GX_VA_POS, GX_POS_XYZ, GX_S16, 0);
+    GX_SetVtxAttrFmt(VTXFMT_COMPACT, GX_VA_TEX0, GX_TEX_ST, GX_U16, TEXCOORD_FRAC);
+
+    GX_SetVtxAttrFmt(VTXFMT_INDEXED, GX_VA_POS, GX_POS_XY, GX_S16, 0);
+    GX_SetVtxAttrFmt(VTXFMT_INDEXED, GX_VA_TEX0, GX_TEX_ST, GX_U16, TEXCOORD_FRAC);
+
+    vertex_mode = mode;
+}
+
+/// Bytes one vertex takes up in the given mode
+int vertex_size(VertexMode mode) {
+    if(mode == VERTEX_COMPACT) return 3 * sizeof(s16) + 2 * sizeof(u16);
+    return 5 * sizeof(f32);
+}
+
+/// Clamps a position into the range of a compact vertex
+s16 to_s16(int value) {
+    if(value > 32767) return 32767;
+    if(value < -32768) return -32768;
+    return (s16)value;
+}
+
+/// Depth of a sprite whose feet are at feet_y, with the top of the
+/// screen at top_y
+int sprite_depth(int feet_y, int top_y) {
+    int depth = DEPTH_SPRITES - (feet_y - top_y);
+    if(depth > DEPTH_SPRITES + 4096) return DEPTH_SPRITES + 4096;
+    if(depth < DEPTH_HUD + 1) return DEPTH_HUD + 1;
+    return depth;
+}
@@ -0,0 +1,60 @@
+/* Counters for what culling let through, reset every frame */
+struct CullStats {
+    int chunks_drawn;
+    int chunks_culled;
+    int parts_culled; // parts of drawn chunks left out of their display list
+    int tiles_drawn;
+    int tiles_culled;
+    int sprites_drawn;
+    int sprites_culled;
+    void reset() {
+        this->chunks_drawn = 0;
+        this->chunks_culled = 0;
+        this->parts_culled = 0;
+        this->tiles_drawn = 0;
+        this->tiles_culled = 0;
+        this->sprites_drawn = 0;
+        this->sprites_culled = 0;
+    }
+};
+
+/* The part of the world a camera can see, used to reject
+ * anything off-screen before it costs any GX work */
+class View {
+public:
+    int left;
+    int top;
+    int right;
+    int bottom;
+    CullStats stats;
+    View() {
+        this->left = 0;
+        this->top = 0;
+        this->right = SCREEN_WIDTH;
+        this->bottom = SCREEN_HEIGHT;
+        this->stats.reset();
+    }
+    /// Sees width by height pixels from the camera at camera_x and camera_y,
+    /// the whole pixel the camera is in. Sprites report bounds that already
+    /// cover their rotation and scale, so nothing needs a margin around it.
+    void set(int camera_x, int camera_y, int width, int height) {
+        this->left = camera_x;
+        this->top = camera_y;
+        // the camera can sit up to a pixel past its whole pixel, which
+        // brings one more column and row into view
+        this->right = camera_x + width + 1;
+        this->bottom = camera_y + height + 1;
+        this->stats.reset();
+    }
+    /// Whether any part of the rectangle is visible
+    bool overlaps(int x, int y, int width, int height) {
+        return x < this->right && x + width > this->left &&
+            y < this->bottom && y + height > this->top;
+    }
+    /// Whether all of the rectangle is visible
+    bool contains(int x, int y, int width, int height) {
+        return x >= this->left && x + width <= this->right &&
+            y >= this->top && y + height <= this->bottom;
+    }
+};
+
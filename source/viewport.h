@@ -0,0 +1,132 @@
+/// Points the GX viewport and scissor at part of the screen, given in
+/// screen pixels
+void set_screen_rect(int left, int top, int width, int height) {
+    f32 scale_x = rmode->fbWidth / (f32)SCREEN_WIDTH;
+    f32 scale_y = rmode->efbHeight / (f32)SCREEN_HEIGHT;
+    GX_SetViewport(left * scale_x, top * scale_y, width * scale_x, height * scale_y, 0, 1);
+    GX_SetScissor(left * scale_x, top * scale_y, width * scale_x, height * scale_y);
+}
+
+/* One player's part of the screen, with its own camera and its own
+ * culling. Everything it draws comes from data shared by all of them. */
+class Viewport {
+public:
+    int left;
+    int top;
+    int width;
+    int height;
+    int player;
+    Camera camera;
+    View view;
+    View layer_view; // of the parallax layer being drawn
+    f32 anchor_x; // where the parallax layers line up with the world,
+    f32 anchor_y; // easing towards the middle of the player's chunk
+    u32 draw_us; // CPU time spent drawing the viewport last frame
+    Viewport() {
+        this->left = 0;
+        this->top = 0;
+        this->width = SCREEN_WIDTH;
+        this->height = SCREEN_HEIGHT;
+        this->player = 0;
+        // the middle of the chunk an area starts around
+        this->anchor_x = CHUNK_SPACING + CHUNK_SPACING / 2;
+        this->anchor_y = CHUNK_SPACING + CHUNK_SPACING / 2;
+        this->draw_us = 0;
+    }
+    void set_rect(int left, int top, int width, int height) {
+        this->left = left;
+        this->top = top;
+        this->width = width;
+        this->height = height;
+        this->camera.width = width;
+        this->camera.height = height;
+    }
+    /// Aims the view at what the camera sees, before anything is culled
+    void update_view() {
+        this->view.set(this->camera.pixel_x(), this->camera.pixel_y(), this->width, this->height);
+    }
+    /// Makes everything drawn after land in the viewport, seen from its camera
+    void begin() {
+        this->look_from(this->camera.x, this->camera.y, 0);
+    }
+    /// Eases the anchor towards the middle of the chunk the player is
+    /// in, so the layers don't jump when the player enters another one
+    void follow_anchor(const Area &area) {
+        f32 target_x = area.centers_x[this->player] * CHUNK_SPACING + CHUNK_SPACING / 2;
+        f32 target_y = area.centers_y[this->player] * CHUNK_SPACING + CHUNK_SPACING / 2;
+        this->anchor_x += (target_x - this->anchor_x) / this->camera.smoothing;
+        this->anchor_y += (target_y - this->anchor_y) / this->camera.smoothing;
+    }
+    /// Like begin(), but for a parallax layer behind the world, and aims
+    /// layer_view at what the layer's camera sees. The layer scrolls
+    /// around the anchor instead of the origin of the world, and is kept
+    /// on the 3x3 chunks the area has loaded around the player.
+    void begin_layer(const ParallaxLayer &layer, const Area &area) {
+        f32 half_width = this->width / 2.0F;
+        f32 half_height = this->height / 2.0F;
+        f32 x = this->anchor_x + (this->camera.x + half_width - this->anchor_x) * layer.speed - half_width + layer.offset;
+        f32 y = this->anchor_y + (this->camera.y + half_height - this->anchor_y) * layer.speed - half_height + layer.offset;
+        f32 left = (area.centers_x[this->player] - 1) * CHUNK_SPACING;
+        f32 top = (area.centers_y[this->player] - 1) * CHUNK_SPACING;
+        x = std::min(std::max(x, left), left + 3 * CHUNK_SPACING - this->width);
+        y = std::min(std::max(y, top), top + 3 * CHUNK_SPACING - this->height);
+        this->layer_view.set((int)floorf(x), (int)floorf(y), this->width, this->height);
+        this->look_from(x, y, layer.depth);
+    }
+private:
+    void look_from(f32 x, f32 y, f32 depth) {
+        set_screen_rect(this->left, this->top, this->width, this->height);
+        load_projection(this->width, this->height);
+        // quads are sent relative to the camera's pixel, so they fit in
+        // compact vertices, and the matrix adds what is left of a pixel
+        sprite_batch.set_origin((int)floorf(x), (int)floorf(y));
+        load_camera(x, y, depth);
+        load_translation(sprite_batch.origin_x, sprite_batch.origin_y, 0);
+    }
+};
+
+/* Splits the screen between everyone playing. Two players get a half
+ * each, one above the other, three or four get a quarter each. */
+class SplitScreen {
+public:
+    Viewport viewports[MAX_PLAYERS];
+    int count;
+    SplitScreen() {
+        this->count = 1;
+    }
+    void layout(int count) {
+        this->count = count;
+        int half_width = SCREEN_WIDTH / 2;
+        int half_height = SCREEN_HEIGHT / 2;
+        for(int n = 0; n < count; n++) {
+            Viewport &viewport = this->viewports[n];
+            viewport.player = n;
+            if(count == 1) {
+                viewport.set_rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+            } else if(count == 2) {
+                viewport.set_rect(0, n * half_height, SCREEN_WIDTH, half_height);
+            } else {
+                viewport.set_rect((n % 2) * half_width, (n / 2) * half_height, half_width, half_height);
+            }
+        }
+    }
+    /// Moves every camera towards its player
+    void follow(const Area &area) {
+        for(int n = 0; n < this->count; n++) {
+            Viewport &viewport = this->viewports[n];
+            Player &followed = players[viewport.player];
+            viewport.camera.follow_smooth(followed.getX(), followed.getY());
+            viewport.follow_anchor(area);
+        }
+    }
+    /// Back to the whole screen, with screen coordinates for the HUD
+    void end() {
+        set_screen_rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+        load_projection(SCREEN_WIDTH, SCREEN_HEIGHT);
+        sprite_batch.set_origin(0, 0);
+        load_camera(0, 0, 0);
+        load_translation(0, 0, 0);
+    }
+};
+
+SplitScreen split_screen;